@@ -0,0 +1,1183 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <math.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <x86intrin.h>
+#include <cpuid.h>
+#include "mountain.h"
+
+#ifndef MADV_COLLAPSE
+#define MADV_COLLAPSE 25
+#endif
+
+#define PAGE_SIZE MOUNTAIN_PAGE_SIZE
+#define HUGE_PAGE_SIZE MOUNTAIN_HUGE_PAGE_SIZE
+#define LINE_SIZE MOUNTAIN_LINE_SIZE
+#define MAX_CACHE_LEVELS MOUNTAIN_MAX_LEVELS
+#define CHASE_LOADS MOUNTAIN_CHASE_LOADS
+
+struct mountain_bench_params const mountain_default_params = {
+    .prime_cache = true,
+    .timer = MOUNTAIN_CLOCK,
+    .k = 5,
+    .max_samples = 300,
+    .shift_samples = 60,
+    .denom = 100,
+    .base_spread = 2        // at least 2 nanoseconds
+};
+
+bool mountain_debug(char const *key) {
+    char *dbg = getenv("DEBUG");
+    return dbg != NULL && ((key && !strcmp(key, dbg)) || !strcmp("*", dbg));
+}
+
+#define debug mountain_debug
+
+static uint64_t rdtsc() {
+    uint64_t tsc, lo;
+    asm volatile ("lfence\n\trdtsc\n\tlfence" : "=a" (lo), "=d" (tsc));
+    return (tsc << 32) | lo;
+}
+
+#define ONE_SEC_NS 1000000000
+uint64_t mountain_now(enum mountain_timer timer) {
+    if (timer == MOUNTAIN_RDTSC) return rdtsc();
+
+    struct timespec ts;
+
+    // CLOCK_MONOTONIC on OSX only supports microsecond precision, and each nanosecond counts
+    if (clock_gettime(CLOCK_MONOTONIC_RAW, &ts)) {
+        fprintf(stderr, "error reading current time\n");
+        abort();
+    }
+
+    return ts.tv_sec * ONE_SEC_NS + ts.tv_nsec;
+}
+
+static bool has_converged(uint64_t *samples, unsigned s, struct mountain_bench_params const p) {
+    uint64_t delta = samples[p.k - 1] - samples[0];
+    uint64_t spread = samples[0] / p.denom + p.base_spread;
+
+    if (s >= p.k && debug("converging"))
+        fprintf(stderr, "converging... delta: %"PRIu64", spread: %"PRIu64"\n", delta, spread);
+
+    return s >= p.k && delta < spread;
+}
+
+static void sort_samples(uint64_t *samples, unsigned i) {
+    unsigned const k = i;
+
+    while (i && samples[i - 1] > samples[i]) {
+        uint64_t t = samples[i - 1];
+        samples[i - 1] = samples[i];
+        samples[i] = t;
+        i--;
+    }
+
+    i = 0;
+    if (debug("sorted")) {
+        fprintf(stderr, "sorted samples (k = %u): [", k);
+        fprintf(stderr, "%"PRIu64"", samples[i++]);
+        while (i <= k)
+            fprintf(stderr, ", %"PRIu64"", samples[i++]);
+        fprintf(stderr, "]\n");
+    }
+}
+
+static unsigned add_sample(
+    uint64_t *samples, unsigned s, uint64_t elapsed,
+    struct mountain_bench_params const p
+) {
+    unsigned i = s < p.k ? s : p.k - 1U;
+
+    if (s < p.k || elapsed < samples[i])
+        samples[i] = elapsed;
+
+    return i;
+}
+
+static void try_shift(uint64_t *samples, unsigned s, struct mountain_bench_params const p) {
+    if (s < p.k || s % p.shift_samples > 0) return;
+
+    unsigned i = 0;
+    while (i < p.k - 1U) samples[i] = samples[i + 1], i++;
+    samples[p.k - 1] = UINT64_MAX;  // add_sample will replace this
+
+    i = 0;
+    if (debug("shifts")) {
+        fprintf(stderr, "shifted: [");
+        fprintf(stderr, "%"PRIu64"", samples[i++]);
+        while (i <= p.k - 1U)
+            fprintf(stderr, ", %"PRIu64"", samples[i++]);
+        fprintf(stderr, "]\n");
+    }
+}
+
+// rdtsc ticks at a constant rate, regardless of actual CPU frequency
+// and so it can be converted to nanoseconds by using cpuid to get the CPU's base frequency
+#define PROC_FREQ_LEAF 0x16
+uint64_t mountain_cycles_to_ns(uint64_t cycles) {
+    static unsigned freq = 0;
+
+    if (!freq) {
+        unsigned b, c, d;
+        __get_cpuid(PROC_FREQ_LEAF, &freq, &b, &c, &d);
+
+        freq = freq / 100; // mhz to ghz * 10
+
+        if (!freq) {
+            fprintf(stderr, "could not determine processor base frequency, check leaf 0x16\n");
+            abort();
+        }
+
+        if (debug("rdstc"))
+            fprintf(stderr, "processor base frequency (ghz * 10): %u\n", freq);
+    }
+
+    return cycles * 10 / freq;
+}
+
+#define CLFLUSHOPT_BIT (1 << 23)
+void mountain_flush(volatile char const *data, uint64_t bytes) {
+    static int clflushopt = -1;
+
+    if (clflushopt < 0) {
+        unsigned a, b, c, d;
+        clflushopt = __get_cpuid_count(7, 0, &a, &b, &c, &d) && (b & CLFLUSHOPT_BIT);
+    }
+
+    // clflushopt is weakly ordered, so many can be in flight at once, the fence waits for all of them
+    if (clflushopt)
+        for (uint64_t i = 0; i < bytes; i += LINE_SIZE) __asm__ volatile ("clflushopt %0" :: "m" (data[i]));
+    else
+        for (uint64_t i = 0; i < bytes; i += LINE_SIZE) _mm_clflush((void const *) &data[i]);
+
+    _mm_mfence();
+}
+
+uint64_t mountain_bench(struct mountain_bench_params const p, void (*fn)(void *args), void *args) {
+    uint64_t samples[p.k];
+    unsigned s = 0;
+
+    // priming would undo the flush
+    if (p.prime_cache && !p.flush)
+        (*fn)(args);
+
+    do {
+        if (p.flush) mountain_flush(p.flush, p.flush_bytes);
+
+        uint64_t start = mountain_now(p.timer);
+        (*fn)(args);
+        uint64_t elapsed = mountain_now(p.timer) - start;
+        if (p.timer == MOUNTAIN_RDTSC) elapsed = mountain_cycles_to_ns(elapsed);
+
+        if (p.samples) p.samples[(*p.nsamples)++] = elapsed;
+        if (p.shift_samples) try_shift(samples, s, p);
+        sort_samples(samples, add_sample(samples, s++, elapsed, p));
+    } while (!has_converged(samples, s, p) && s < p.max_samples);
+
+    if (debug("collection"))
+        fprintf(stderr, "collected %d samples, result: %"PRIu64"\n", s, samples[0]);
+
+    return samples[0];
+}
+
+static int compare_samples(void const *a, void const *b) {
+    uint64_t const x = *(uint64_t const *) a, y = *(uint64_t const *) b;
+    return (x > y) - (x < y);
+}
+
+static uint64_t percentile(uint64_t const *sorted, unsigned n, unsigned pct) {
+    unsigned const rank = (n * pct + 99) / 100;
+    return sorted[rank ? rank - 1 : 0];
+}
+
+// the buckets grow with the distance from the minimum, a second mode or an interrupt shows up as
+// counts past the first few buckets, and they stay comparable across sizes
+static unsigned const hist_limits[MOUNTAIN_HIST_BUCKETS - 1] = { 105, 110, 125, 150, 200, 400, 800 };
+
+void mountain_distribution(uint64_t const *samples, unsigned n, struct mountain_distribution *d) {
+    uint64_t sorted[n];
+    memcpy(sorted, samples, n * sizeof *sorted);
+    qsort(sorted, n, sizeof *sorted, compare_samples);
+
+    d->min = sorted[0];
+    d->p50 = percentile(sorted, n, 50);
+    d->p90 = percentile(sorted, n, 90);
+    d->p99 = percentile(sorted, n, 99);
+    d->max = sorted[n - 1];
+
+    memset(d->hist, 0, sizeof d->hist);
+    unsigned b = 0;
+    for (unsigned i = 0; i < n; i++) {
+        while (b < MOUNTAIN_HIST_BUCKETS - 1 && sorted[i] * 100 > d->min * hist_limits[b]) b++;
+        d->hist[b]++;
+    }
+}
+
+// the element types are unaligned so that the align and alias sweeps can start a stream at any byte,
+// unaligned loads and stores cost the same as aligned ones when the address happens to be aligned
+typedef uint64_t uint64_u __attribute__((aligned(1)));
+
+#define define_read_data(name, T)                                       \
+static void name##_read_data(void *args) {                              \
+    struct mountain_read_args const *a = args;                          \
+    volatile T *data = a->data;                                         \
+    for (uint64_t i = 0; i < a->n; i += a->stride) data[i];             \
+    _mm_lfence();                                                       \
+}                                                                       \
+                                                                        \
+static void name##_read_data_sink(void *args) {                         \
+    struct mountain_read_args const *a = args;                          \
+    volatile T *data = a->data;                                         \
+    volatile T sink = { 0 };                                            \
+    T res = { 0 };                                                      \
+    for (uint64_t i = 0; i < a->n; i += a->stride) res += data[i];      \
+    sink = res;                                                         \
+}                                                                       \
+                                                                        \
+static void name##_copy_data(void *args) {                              \
+    struct mountain_read_args const *a = args;                          \
+    volatile T *data = a->data, *dst = a->dst;                          \
+    for (uint64_t i = 0; i < a->n; i += a->stride) dst[i] = data[i];    \
+    _mm_sfence();                                                       \
+}
+
+define_read_data(uint64, uint64_u)
+define_read_data(avx2, __m256i_u)
+
+// the results are summed and handed to an empty asm so that fetch_add stays an xadd instead of becoming a lock add
+#define WORDS_PER_LINE (LINE_SIZE / sizeof (uint64_t))
+#define define_atomic(name, op)                                                         \
+static void name##_data(void *args) {                                                   \
+    struct mountain_read_args const *a = args;                                          \
+    uint64_t *data = (uint64_t *) a->data;                                              \
+    uint64_t res = 0;                                                                   \
+    if (a->one_line)                                                                    \
+        for (uint64_t i = 0; i < a->n; i += a->stride) {                                \
+            uint64_t *p = &data[i & (WORDS_PER_LINE - 1)];                              \
+            res += op;                                                                  \
+        }                                                                               \
+    else if (a->false_sharing)                                                          \
+        for (uint64_t i = 0; i < a->n; i += a->stride) {                                \
+            uint64_t *p = &data[(i & ~(WORDS_PER_LINE - 1)) + a->lane];                 \
+            res += op;                                                                  \
+        }                                                                               \
+    else                                                                                \
+        for (uint64_t i = 0; i < a->n; i += a->stride) {                                \
+            uint64_t *p = &data[i];                                                     \
+            res += op;                                                                  \
+        }                                                                               \
+    __asm__ volatile ("" :: "r" (res));                                                 \
+}
+
+static inline uint64_t cas(uint64_t *p) {
+    uint64_t expected = __atomic_load_n(p, __ATOMIC_RELAXED);
+    return __atomic_compare_exchange_n(p, &expected, expected + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+}
+
+define_atomic(fetch_add, __atomic_fetch_add(p, 1, __ATOMIC_SEQ_CST))
+define_atomic(cas, cas(p))
+define_atomic(xchg, __atomic_exchange_n(p, i, __ATOMIC_SEQ_CST))
+
+void (*const mountain_kernels[MOUNTAIN_KERNELS])(void *args) = {
+    [MOUNTAIN_UINT64]      = uint64_read_data,
+    [MOUNTAIN_UINT64_SINK] = uint64_read_data_sink,
+    [MOUNTAIN_AVX2]        = avx2_read_data,
+    [MOUNTAIN_AVX2_SINK]   = avx2_read_data_sink,
+    [MOUNTAIN_FETCH_ADD]   = fetch_add_data,
+    [MOUNTAIN_CAS]         = cas_data,
+    [MOUNTAIN_XCHG]        = xchg_data
+};
+
+void (*const mountain_copy_kernels[MOUNTAIN_KERNELS])(void *args) = {
+    [MOUNTAIN_UINT64]      = uint64_copy_data,
+    [MOUNTAIN_UINT64_SINK] = uint64_copy_data,
+    [MOUNTAIN_AVX2]        = avx2_copy_data,
+    [MOUNTAIN_AVX2_SINK]   = avx2_copy_data
+};
+
+size_t mountain_element_size(enum mountain_kernel k) {
+    switch (k) {
+        case MOUNTAIN_UINT64:
+        case MOUNTAIN_UINT64_SINK:
+        case MOUNTAIN_FETCH_ADD:
+        case MOUNTAIN_CAS:
+        case MOUNTAIN_XCHG:
+        default:
+            return sizeof (uint64_t);
+        case MOUNTAIN_AVX2:
+        case MOUNTAIN_AVX2_SINK:
+            return sizeof (__m256i);
+    }
+}
+
+char const *mountain_kernel_str(enum mountain_kernel k) {
+    switch (k) {
+        default:
+        case MOUNTAIN_UINT64:      return "uint64";
+        case MOUNTAIN_UINT64_SINK: return "uint64_sink";
+        case MOUNTAIN_AVX2:        return "avx2";
+        case MOUNTAIN_AVX2_SINK:   return "avx2_sink";
+        case MOUNTAIN_FETCH_ADD:   return "fetch_add";
+        case MOUNTAIN_CAS:         return "cas";
+        case MOUNTAIN_XCHG:        return "xchg";
+    }
+}
+
+// deterministic cache parameters, AMD reports them in an extended leaf with the same layout
+#define CACHE_PARAMS_LEAF 0x4
+#define AMD_CACHE_PARAMS_LEAF 0x8000001d
+#define DATA_CACHE 1
+#define INSTRUCTION_CACHE 2
+unsigned mountain_cache_levels(struct mountain_cache_level *levels, unsigned max) {
+    unsigned a, b, c, d, leaf = CACHE_PARAMS_LEAF, n = 0;
+
+    if (__get_cpuid(0, &a, &b, &c, &d) && b == signature_AMD_ebx)
+        leaf = AMD_CACHE_PARAMS_LEAF;
+
+    for (unsigned i = 0; n < max && __get_cpuid_count(leaf, i, &a, &b, &c, &d); i++) {
+        unsigned const type = a & 0x1f;
+        if (!type) break;
+        if (type == INSTRUCTION_CACHE) continue;
+
+        struct mountain_cache_level *l = &levels[n++];
+        l->level = (a >> 5) & 0x7;
+        l->line_size = (b & 0xfff) + 1;
+        l->ways = ((b >> 22) & 0x3ff) + 1;
+        l->sets = c + 1;
+        l->size = (uint64_t) l->ways * (((b >> 12) & 0x3ff) + 1) * l->line_size * l->sets;
+
+        if (debug("cache_levels"))
+            fprintf(stderr, "L%u: %"PRIu64" bytes, %u byte lines, %u ways, %u sets\n",
+                l->level, l->size, l->line_size, l->ways, l->sets);
+    }
+
+    return n;
+}
+
+unsigned mountain_level_of(uint64_t size, struct mountain_cache_level const *levels, unsigned n) {
+    unsigned i = 0;
+    while (i < n && size > levels[i].size) i++;
+    return i;
+}
+
+struct fill_args {
+    pthread_t thread;
+    char *buf;
+    uint64_t bytes;
+    uint8_t fill;
+};
+
+// non-temporal stores write around the caches, so filling a buffer many times their size
+// neither reads every line in first nor evicts everything on the way
+static void *stream_fill(void *args) {
+    struct fill_args const *a = args;
+    uint64_t head = -(uintptr_t) a->buf & (sizeof (__m256i) - 1);
+    if (head > a->bytes) head = a->bytes;
+
+    memset(a->buf, a->fill, head);
+
+    __m256i const v = _mm256_set1_epi8((char) a->fill);
+    uint64_t i = head;
+    for (; i + sizeof v <= a->bytes; i += sizeof v) _mm256_stream_si256((__m256i *) (a->buf + i), v);
+
+    memset(a->buf + i, a->fill, a->bytes - i);
+    _mm_sfence();
+    return NULL;
+}
+
+// the first touch of each page is a fault, at hundreds of GB faulting them in from one thread takes minutes,
+// so large buffers are split between up to one thread per cpu, each filling its own chunk
+#define FILL_CHUNK (UINT64_C(1) << 28)
+static void parallel_fill(void *buf, uint64_t bytes, uint8_t fill) {
+    long const cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    uint64_t nthreads = (bytes + FILL_CHUNK - 1) / FILL_CHUNK;
+    if (cpus > 0 && nthreads > (uint64_t) cpus) nthreads = cpus;
+    if (nthreads > MOUNTAIN_MAX_THREADS) nthreads = MOUNTAIN_MAX_THREADS;
+    if (!nthreads) nthreads = 1;
+
+    // page sized chunks, so no page is faulted in by two threads
+    uint64_t const chunk = (bytes / nthreads + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+    struct fill_args fills[nthreads];
+    bool started[nthreads];
+
+    for (unsigned t = 0; t < nthreads; t++) {
+        uint64_t const off = t * chunk < bytes ? t * chunk : bytes;
+        fills[t] = (struct fill_args) { .buf = (char *) buf + off, .bytes = bytes - off < chunk ? bytes - off : chunk, .fill = fill };
+        // the calling thread takes the first chunk, and any that a thread couldn't be started for
+        started[t] = t && !pthread_create(&fills[t].thread, NULL, stream_fill, &fills[t]);
+    }
+
+    for (unsigned t = 0; t < nthreads; t++)
+        if (!started[t]) stream_fill(&fills[t]);
+    for (unsigned t = 0; t < nthreads; t++)
+        if (started[t]) pthread_join(fills[t].thread, NULL);
+
+    if (debug("prepare"))
+        fprintf(stderr, "filled %"PRIu64" bytes from %"PRIu64" threads\n", bytes, nthreads);
+}
+
+// fresh anonymous pages all map the shared zero page until they're written, so a "DRAM" sized buffer
+// that's only ever read measures a single page in L1, and the first size takes every page fault,
+// so write every page up front, optionally lock them in, and check they're all resident
+bool mountain_prepare(void *buf, uint64_t bytes, uint8_t fill, bool lock) {
+    uint64_t const start = mountain_now(MOUNTAIN_CLOCK);
+
+    parallel_fill(buf, bytes, fill);
+
+    if (lock && mlock(buf, bytes)) {
+        perror("mlock");
+        return false;
+    }
+
+    uint64_t const pages = (bytes + PAGE_SIZE - 1) / PAGE_SIZE;
+    unsigned char *vec = malloc(pages);
+    if (!vec) {
+        fprintf(stderr, "residency vector allocation failed\n");
+        return false;
+    }
+
+    uint64_t missing = 0;
+    if (mincore(buf, bytes, vec)) perror("mincore");
+    else for (uint64_t i = 0; i < pages; i++) missing += !(vec[i] & 1);
+
+    free(vec);
+
+    if (missing)
+        fprintf(stderr, "%"PRIu64" of %"PRIu64" buffer pages are not resident\n", missing, pages);
+
+    if (debug("prepare"))
+        fprintf(stderr, "prepared %"PRIu64" pages in %"PRIu64" ns\n", pages, mountain_now(MOUNTAIN_CLOCK) - start);
+
+    return true;
+}
+
+static bool read_uj(char const *path, uint64_t *uj) {
+    FILE *f = fopen(path, "r");
+    if (!f) return false;
+    bool const ok = fscanf(f, "%"SCNu64, uj) == 1;
+    fclose(f);
+    return ok;
+}
+
+static bool zone_path(char *path, char const *root, char const *zone, char const *file) {
+    return snprintf(path, MOUNTAIN_PATH_MAX, "%s/%s/%s", root, zone, file) < MOUNTAIN_PATH_MAX;
+}
+
+// the zones are listed flat under the powercap class, intel-rapl:0 for the first package,
+// intel-rapl:0:0 for its subzones, and what a zone covers is only given by its name
+#define RAPL_PREFIX "intel-rapl:"
+bool mountain_rapl_open(struct mountain_rapl *r, char const *root) {
+    if (!root) root = "/sys/class/powercap";
+
+    DIR *dir = opendir(root);
+    if (!dir) {
+        fprintf(stderr, "could not open %s\n", root);
+        return false;
+    }
+
+    r->n = 0;
+    struct dirent *e;
+    while ((e = readdir(dir)) && r->n < MOUNTAIN_MAX_ZONES) {
+        if (strncmp(e->d_name, RAPL_PREFIX, strlen(RAPL_PREFIX))) continue;
+
+        char path[MOUNTAIN_PATH_MAX], name[32] = "";
+        FILE *f = zone_path(path, root, e->d_name, "name") ? fopen(path, "r") : NULL;
+        if (!f) continue;
+        if (!fgets(name, sizeof name, f)) name[0] = '\0';
+        fclose(f);
+
+        struct mountain_rapl_zone *z = &r->zones[r->n];
+        if (!strncmp(name, "package", strlen("package"))) z->kind = MOUNTAIN_PACKAGE;
+        else if (!strncmp(name, "dram", strlen("dram")))  z->kind = MOUNTAIN_DRAM;
+        else continue;
+
+        uint64_t uj;
+        if (!zone_path(path, root, e->d_name, "max_energy_range_uj") || !read_uj(path, &z->max_uj))
+            z->max_uj = UINT64_MAX;
+        if (!zone_path(z->path, root, e->d_name, "energy_uj")) continue;
+        if (!read_uj(z->path, &uj)) {
+            fprintf(stderr, "could not read %s, it may need root\n", z->path);
+            continue;
+        }
+
+        if (debug("rapl"))
+            fprintf(stderr, "rapl zone %s: %s, wraps at %"PRIu64" uj\n",
+                e->d_name, z->kind == MOUNTAIN_PACKAGE ? "package" : "dram", z->max_uj);
+
+        r->n++;
+    }
+
+    closedir(dir);
+
+    if (!r->n) fprintf(stderr, "no readable package or dram rapl zones under %s\n", root);
+    return r->n > 0;
+}
+
+bool mountain_rapl_read(struct mountain_rapl const *r, uint64_t *uj) {
+    for (unsigned i = 0; i < r->n; i++)
+        if (!read_uj(r->zones[i].path, &uj[i])) return false;
+    return true;
+}
+
+// a counter that went backwards wrapped once, the windows are far shorter than the minutes a wrap takes
+void mountain_rapl_energy(struct mountain_rapl const *r, uint64_t const *before, uint64_t const *after, double *uj) {
+    for (unsigned k = 0; k < MOUNTAIN_RAPL_KINDS; k++) uj[k] = NAN;
+
+    for (unsigned i = 0; i < r->n; i++) {
+        struct mountain_rapl_zone const *z = &r->zones[i];
+        uint64_t const delta = after[i] >= before[i] ? after[i] - before[i] : z->max_uj - before[i] + after[i];
+        uj[z->kind] = (isnan(uj[z->kind]) ? 0 : uj[z->kind]) + delta;
+    }
+}
+
+// the counters only update about once a millisecond, far slower than a sample,
+// so energy is measured over a separate window of back to back runs, NAN if the counters can't be read
+#define ENERGY_WINDOW_NS (20 * 1000 * 1000)
+static void measure_energy(
+    struct mountain_rapl const *r, void (*fn)(void *args), void *args,
+    uint64_t bytes, double *nj_per_byte
+) {
+    uint64_t before[r->n], after[r->n], runs = 0;
+    for (unsigned k = 0; k < MOUNTAIN_RAPL_KINDS; k++) nj_per_byte[k] = NAN;
+
+    if (!mountain_rapl_read(r, before)) return;
+    uint64_t const start = mountain_now(MOUNTAIN_CLOCK);
+    do (*fn)(args), runs++;
+    while (mountain_now(MOUNTAIN_CLOCK) - start < ENERGY_WINDOW_NS);
+    if (!mountain_rapl_read(r, after)) return;
+
+    double uj[MOUNTAIN_RAPL_KINDS];
+    mountain_rapl_energy(r, before, after, uj);
+    for (unsigned k = 0; k < MOUNTAIN_RAPL_KINDS; k++)
+        nj_per_byte[k] = uj[k] * 1000 / ((double) runs * bytes);
+
+    if (debug("energy"))
+        fprintf(stderr, "energy window: %"PRIu64" runs of %"PRIu64" bytes\n", runs, bytes);
+}
+
+unsigned mountain_sweep_sizes(struct mountain_sweep const *s) {
+    return s->max_size_p2 - s->min_size_p2 + 1;
+}
+
+unsigned mountain_sweep_strides(struct mountain_sweep const *s) {
+    return (unsigned) ((s->end_stride - s->start_stride) / s->stride_interval + 1);
+}
+
+unsigned mountain_sweep_offset_count(struct mountain_sweep const *s, enum mountain_offsets kind) {
+    return kind == MOUNTAIN_ALIAS ? PAGE_SIZE / LINE_SIZE : (LINE_SIZE + s->offset_step - 1) / s->offset_step;
+}
+
+// the next point's slice of the sample arena, if the sweep records samples
+static uint64_t *record_samples(
+    struct mountain_sweep const *s, struct mountain_bench_params *p,
+    uint64_t **next, unsigned *n
+) {
+    if (!s->samples) return NULL;
+
+    uint64_t *const samples = *next;
+    *next += s->params.max_samples;
+    *n = 0;
+    p->samples = samples, p->nsamples = n;
+    return samples;
+}
+
+struct helper {
+    pthread_t thread;
+    void (*fn)(void *args);
+    struct mountain_read_args args;
+    atomic_bool *stop;
+    atomic_uint *running;
+};
+
+static void *hammer(void *arg) {
+    struct helper *h = arg;
+    atomic_fetch_add(h->running, 1);
+    while (!atomic_load_explicit(h->stop, memory_order_relaxed)) (*h->fn)(&h->args);
+    return NULL;
+}
+
+static void stop_helpers(struct helper *helpers, unsigned n, atomic_bool *stop) {
+    atomic_store(stop, true);
+    for (unsigned i = 0; i < n; i++) pthread_join(helpers[i].thread, NULL);
+}
+
+// the other threads run the point's kernel until stopped, and are all running before it's timed
+static bool start_helpers(
+    struct mountain_sweep const *s, struct mountain_read_args const *args,
+    struct helper *helpers, atomic_bool *stop, atomic_uint *running
+) {
+    uint64_t const span = (UINT64_C(1) << s->max_size_p2) + PAGE_SIZE;
+    unsigned const n = s->threads - 1U;
+    atomic_store(stop, false);
+    atomic_store(running, 0);
+
+    for (unsigned i = 0; i < n; i++) {
+        struct helper *h = &helpers[i];
+        *h = (struct helper) { .fn = mountain_kernels[s->kernel], .args = *args, .stop = stop, .running = running };
+        if (s->contention == MOUNTAIN_DISJOINT) h->args.data = (volatile char *) args->data + (i + 1) * span;
+        if (s->contention == MOUNTAIN_FALSE_SHARING) h->args.lane = i + 1;
+
+        if (pthread_create(&h->thread, NULL, hammer, h)) {
+            fprintf(stderr, "could not start thread %u\n", i + 1);
+            stop_helpers(helpers, i, stop);
+            return false;
+        }
+    }
+
+    while (atomic_load(running) < n) sched_yield();
+    return true;
+}
+
+bool mountain_sweep(
+    struct mountain_sweep const *s, volatile char *data,
+    struct mountain_grid *g, struct mountain_callbacks const *cb
+) {
+    struct helper helpers[s->threads > 1 ? s->threads - 1 : 1];
+    atomic_bool stop;
+    atomic_uint running;
+    uint64_t *next = s->samples;
+    unsigned i = g->nsizes;
+    for (uint64_t size = UINT64_C(1) << s->max_size_p2; size >= UINT64_C(1) << s->min_size_p2; size >>= 1) {
+        g->sizes[--i] = size;
+
+        // counted rather than stepped until past end_stride, which can wrap around near UINT64_MAX
+        for (unsigned j = 0; j < g->nstrides; j++) {
+            uint64_t const stride = s->start_stride + j * s->stride_interval;
+            struct mountain_read_args fargs = {
+                .data = data + s->offset,
+                .n = size / mountain_element_size(s->kernel),
+                .stride = stride,
+                .one_line = s->contention == MOUNTAIN_LINE,
+                .false_sharing = s->contention == MOUNTAIN_FALSE_SHARING
+            };
+            struct mountain_bench_params p = s->params;
+            if (s->flush) p.flush = data + s->offset, p.flush_bytes = size;
+
+            unsigned nsamples = 0;
+            uint64_t const *samples = record_samples(s, &p, &next, &nsamples);
+
+            if (s->threads > 1 && !start_helpers(s, &fargs, helpers, &stop, &running)) return false;
+
+            struct mountain_point point = {
+                .x = stride,
+                .size = size,
+                .ns = mountain_bench(p, mountain_kernels[s->kernel], &fargs),
+                .samples = samples,
+                .nsamples = nsamples
+            };
+
+            if (s->threads > 1) stop_helpers(helpers, s->threads - 1U, &stop);
+
+            if (s->rapl) {
+                uint64_t const bytes = (fargs.n + stride - 1) / stride * mountain_element_size(s->kernel);
+                measure_energy(s->rapl, mountain_kernels[s->kernel], &fargs, bytes, point.nj_per_byte);
+                point.energy = true;
+            }
+            (*cb->point)(cb->ctx, &point);
+
+            g->strides[j] = stride;
+            if (g->times) g->times[i * g->nstrides + j] = point.ns;
+        }
+
+        if (cb->row) (*cb->row)(cb->ctx, size);
+    }
+
+    return true;
+}
+
+// time each offset at every size, and how much slower each is than the fastest offset at that size
+void mountain_sweep_offsets(
+    struct mountain_sweep const *s, enum mountain_offsets kind, volatile char *base, uint64_t span,
+    struct mountain_penalty *penalties, struct mountain_callbacks const *cb
+) {
+    struct mountain_cache_level levels[MAX_CACHE_LEVELS];
+    unsigned const nlevels = mountain_cache_levels(levels, MAX_CACHE_LEVELS);
+    memset(penalties, 0, (MAX_CACHE_LEVELS + 1) * sizeof *penalties);
+
+    bool const alias = kind == MOUNTAIN_ALIAS;
+    unsigned const step = alias ? LINE_SIZE : s->offset_step,
+                   noffsets = mountain_sweep_offset_count(s, kind);
+    uint64_t *next = s->samples;
+    void (*fn)(void *args) = alias ? mountain_copy_kernels[s->kernel] : mountain_kernels[s->kernel];
+
+    for (uint64_t size = UINT64_C(1) << s->max_size_p2; size >= UINT64_C(1) << s->min_size_p2; size >>= 1) {
+        uint64_t times[noffsets], min = UINT64_MAX;
+        uint64_t const *samples[noffsets];
+        unsigned nsamples[noffsets];
+
+        for (unsigned i = 0; i < noffsets; i++) {
+            unsigned const off = i * step;
+            struct mountain_read_args fargs = {
+                .data = alias ? base + s->offset : base + off,
+                .dst = alias ? base + span + off : NULL,
+                .n = size / mountain_element_size(s->kernel),
+                .stride = s->start_stride
+            };
+
+            struct mountain_bench_params p = s->params;
+            if (s->flush) p.flush = fargs.data, p.flush_bytes = size;
+            samples[i] = record_samples(s, &p, &next, &nsamples[i]);
+
+            times[i] = mountain_bench(p, fn, &fargs);
+            if (times[i] < min) min = times[i];
+        }
+
+        // the alias sweep writes as much as it reads, so it needs twice the size in cache
+        struct mountain_penalty *p = &penalties[mountain_level_of(alias ? 2 * size : size, levels, nlevels)];
+        for (unsigned i = 0; i < noffsets; i++) {
+            struct mountain_point const point = {
+                .x = i * step,
+                .size = size,
+                .ns = times[i],
+                .penalty = 100.0 * (times[i] - min) / min,
+                .samples = samples[i],
+                .nsamples = samples[i] ? nsamples[i] : 0
+            };
+            (*cb->point)(cb->ctx, &point);
+
+            p->sum += point.penalty, p->n++;
+            if (point.penalty > p->max) p->max = point.penalty, p->max_offset = point.x;
+        }
+
+        if (cb->row) (*cb->row)(cb->ctx, size);
+    }
+}
+
+static uint64_t grid_time(struct mountain_grid const *g, unsigned i, unsigned j) {
+    uint64_t const t = g->times[i * g->nstrides + j];
+    return t > g->overhead ? t - g->overhead : 1;
+}
+
+// nanoseconds per element read, each read touches a new line once stride * element size >= line size
+static double ns_per_read(struct mountain_grid const *g, unsigned i, unsigned j, size_t elsz) {
+    return (double) grid_time(g, i, j) * g->strides[j] * elsz / g->sizes[i];
+}
+
+static double mb_per_sec(struct mountain_grid const *g, unsigned i, unsigned j) {
+    return g->sizes[i] * 1000.0 / ((double) g->strides[j] * grid_time(g, i, j));
+}
+
+// dependent loads, each one has to complete before the next address is known,
+// picks up where the last call left off so that long chains are walked in full across samples
+void mountain_chase(void *args) {
+    struct mountain_chase_args *a = args;
+    void *volatile *p = a->head;
+    for (uint64_t i = 0; i < a->loads; i++) p = *p;
+    a->head = p;
+}
+
+#define MAX_WARM_LOADS (1 << 22)
+double mountain_chase_ns(struct mountain_bench_params const params, void *volatile *head, uint64_t nodes) {
+    struct mountain_chase_args fargs = { head, nodes < MAX_WARM_LOADS ? nodes : MAX_WARM_LOADS };
+    mountain_chase(&fargs);
+
+    fargs.loads = CHASE_LOADS;
+    return (double) mountain_bench(params, mountain_chase, &fargs) / CHASE_LOADS;
+}
+
+// one node per line, linked in a random cycle (Sattolo's shuffle) that the prefetchers can't follow,
+// at least one node, which points at itself
+void *volatile *mountain_random_chain(volatile char *base, uint64_t nodes, uint64_t *order) {
+    uint64_t x = UINT64_C(0x9e3779b97f4a7c15);
+    if (!nodes) nodes = 1;
+
+    for (uint64_t i = 0; i < nodes; i++) order[i] = i;
+    for (uint64_t i = nodes - 1; i > 0; i--) {
+        x ^= x << 13, x ^= x >> 7, x ^= x << 17;    // xorshift64
+        uint64_t const j = x % i, t = order[i];
+        order[i] = order[j], order[j] = t;
+    }
+
+    for (uint64_t i = 0; i < nodes; i++)
+        *(void *volatile *) (base + i * LINE_SIZE) = (void *) (base + order[i] * LINE_SIZE);
+
+    return (void *volatile *) base;
+}
+
+// a multiple of sets * line size apart puts them all in the same set
+void *volatile *mountain_conflict_chain(volatile char *base, unsigned k, uint64_t spacing) {
+    for (unsigned i = 0; i < k; i++)
+        *(void *volatile *) (base + i * spacing) = (void *) (base + (i + 1) % k * spacing);
+
+    return (void *volatile *) base;
+}
+
+// the stream loop is the innermost so that every stream has a miss in flight at once
+void mountain_streams(void *args) {
+    struct mountain_streams_args const *a = args;
+    uint64_t const end = a->lines * LINE_SIZE;
+    for (uint64_t i = 0; i < end; i += LINE_SIZE)
+        for (unsigned s = 0; s < a->streams; s++) *(volatile uint64_t *) (a->data + s * a->region + i);
+    _mm_lfence();
+}
+
+void mountain_chase_chains(void *args) {
+    struct mountain_chains_args *a = args;
+    void *volatile *p[MOUNTAIN_MAX_STREAMS];
+    for (unsigned c = 0; c < a->chains; c++) p[c] = a->heads[c];
+
+    for (uint64_t i = 0; i < a->loads; i++)
+        for (unsigned c = 0; c < a->chains; c++) p[c] = *p[c];
+
+    for (unsigned c = 0; c < a->chains; c++) a->heads[c] = p[c];
+}
+
+// every chain gets its own region of the size, and is walked once before it's timed
+static void build_chains(
+    struct mountain_chains_args *a, volatile char *data,
+    uint64_t region, uint64_t *order
+) {
+    uint64_t const nodes = region / LINE_SIZE,
+                   warm = nodes < MAX_WARM_LOADS ? nodes : MAX_WARM_LOADS;
+
+    for (unsigned c = 0; c < a->chains; c++) {
+        struct mountain_chase_args w = { mountain_random_chain(data + c * region, nodes, order), warm };
+        mountain_chase(&w);
+        a->heads[c] = w.head;
+    }
+}
+
+bool mountain_sweep_streams(
+    struct mountain_sweep const *s, enum mountain_streams kind,
+    volatile char *data, struct mountain_callbacks const *cb
+) {
+    uint64_t *order = NULL;
+    if (kind == MOUNTAIN_CHAINS && !(order = malloc(((UINT64_C(1) << s->max_size_p2) / LINE_SIZE) * sizeof *order))) {
+        fprintf(stderr, "chain allocation failed\n");
+        return false;
+    }
+
+    uint64_t *next = s->samples;
+    for (uint64_t size = UINT64_C(1) << s->max_size_p2; size >= UINT64_C(1) << s->min_size_p2; size >>= 1) {
+        for (unsigned n = 1; n <= s->max_streams; n++) {
+            uint64_t const region = size / n / LINE_SIZE * LINE_SIZE;
+            if (!region) break;
+
+            struct mountain_bench_params p = s->params;
+            if (s->flush) p.flush = data, p.flush_bytes = size;
+
+            unsigned nsamples = 0;
+            uint64_t const *samples = record_samples(s, &p, &next, &nsamples);
+
+            struct mountain_point point = { .x = n, .size = size };
+            if (kind == MOUNTAIN_STREAMS) {
+                struct mountain_streams_args fargs = { data, region, region / LINE_SIZE, n };
+                point.ns = mountain_bench(p, mountain_streams, &fargs);
+                point.loads = fargs.lines * n;
+            } else {
+                // the same number of loads at every chain count keeps each sample about as long
+                struct mountain_chains_args fargs = { .chains = n, .loads = CHASE_LOADS / n };
+                build_chains(&fargs, data, region, order);
+                point.ns = mountain_bench(p, mountain_chase_chains, &fargs);
+                point.loads = fargs.loads * n;
+            }
+
+            point.samples = samples, point.nsamples = nsamples;
+            (*cb->point)(cb->ctx, &point);
+        }
+
+        if (cb->row) (*cb->row)(cb->ctx, size);
+    }
+
+    free(order);
+    return true;
+}
+
+#define CLIFF_RATIO 1.5     // latency has to grow by more than 50% to count as a new level
+#define MAX_WAYS 32
+
+struct level_estimate {
+    unsigned start, end;    // indices of the first and last size in the plateau
+};
+
+static double median3(double a, double b, double c) {
+    return a < b ? (b < c ? b : a < c ? c : a) : (a < c ? a : b < c ? c : b);
+}
+
+// the time per read at a size that hits in L2 steps up once every read needs its own line filled into L1,
+// out in L3 and memory adjacent line prefetchers blur that step to twice the line, so at each L2 size the
+// line is the power of two between the two strides either side of the best fitting single step, and the
+// estimate is only trusted when at least two sizes find a step and all of those agree, which needs the
+// strides to start below a line and step by less than one, 0 when unknown
+#define STEP_RATIO 1.05     // the step has to lift the time per read by more than 5%
+static unsigned line_at_size(struct mountain_grid const *g, unsigned i, size_t elsz) {
+    // stride 1 is a sequential stream the L1 prefetcher serves faster than any other stride, so leave it out
+    uint64_t const *strides = g->strides + 1;
+    unsigned const n = g->nstrides - 1;
+    double raw[n], t[n], total = 0;
+    for (unsigned j = 0; j < n; j++) raw[j] = ns_per_read(g, i, j + 1, elsz);
+
+    // set aliasing spikes single power of two strides, a median of three keeps the step and drops those
+    for (unsigned j = 0; j < n; j++) {
+        unsigned const k = j + 1 < n ? j : n - 2;
+        total += t[j] = j ? median3(raw[k - 1], raw[k], raw[k + 1]) : raw[0];
+    }
+
+    unsigned step = 0;
+    double best = INFINITY, left_mean = 0, right_mean = 0;
+    for (unsigned j = 1; j + 1 < n; j++) {
+        double left = 0, sse = 0;
+        for (unsigned k = 0; k < j; k++) left += t[k];
+        double const lm = left / j, rm = (total - left) / (n - j);
+        for (unsigned k = 0; k < n; k++) sse += (t[k] - (k < j ? lm : rm)) * (t[k] - (k < j ? lm : rm));
+
+        if (sse < best) best = sse, step = j, left_mean = lm, right_mean = rm;
+    }
+
+    if (!step || right_mean < left_mean * STEP_RATIO) return 0;
+
+    uint64_t const below = strides[step - 1] * elsz, above = strides[step] * elsz;
+    uint64_t line = elsz;
+    while (line << 1 <= above) line <<= 1;
+
+    return line > below ? line : 0;
+}
+
+static unsigned estimate_line_size(
+    struct mountain_grid const *g, size_t elsz, struct level_estimate const *levels, unsigned nlevels
+) {
+    // the second plateau is L2 unless there's only one cache level
+    if (nlevels < 3 || g->nstrides < 4) return 0;
+
+    struct level_estimate const *l2 = &levels[1];
+    unsigned const nsizes = l2->end - l2->start + 1;
+    unsigned lines[nsizes];
+    for (unsigned i = 0; i < nsizes; i++) {
+        lines[i] = line_at_size(g, l2->start + i, elsz);
+
+        if (debug("line_size"))
+            fprintf(stderr, "line size at %"PRIu64" bytes: %u\n", g->sizes[l2->start + i], lines[i]);
+    }
+
+    unsigned line = 0, found = 0;
+    for (unsigned i = 0; i < nsizes; i++) {
+        if (!lines[i]) continue;
+        if (line && lines[i] != line) return 0;
+        line = lines[i], found++;
+    }
+
+    return found >= 2 ? line : 0;
+}
+
+// split the sizes into latency plateaus, a single size between two steps is
+// a partially cached transition and is folded into the next plateau
+static unsigned find_levels(struct level_estimate *levels, unsigned max, double const *ns, unsigned nsizes) {
+    unsigned n = 1;
+    double floor = ns[0];
+    levels[0] = (struct level_estimate) { .start = 0 };
+
+    for (unsigned i = 1; i < nsizes; i++) {
+        struct level_estimate *l = &levels[n - 1];
+
+        if (ns[i] <= floor * CLIFF_RATIO) {
+            if (ns[i] < floor) floor = ns[i];
+            continue;
+        }
+
+        if (n > 1 && i - l->start == 1) l->start = i;
+        else if (n < max) l->end = i - 1, levels[n++] = (struct level_estimate) { .start = i };
+        else break;
+
+        floor = ns[i];
+    }
+
+    levels[n - 1].end = nsizes - 1;
+
+    return n;
+}
+
+// the latency of a level is its fastest size, the sustained bandwidth is the median of its unit stride reads
+static void level_stats(
+    struct mountain_profile *profile, struct level_estimate const *levels, unsigned n,
+    uint64_t const *sizes, double const *ns, double const *mbs
+) {
+    profile->nlevels = n;
+
+    for (unsigned i = 0; i < n; i++) {
+        struct level_estimate const *e = &levels[i];
+        struct mountain_level *l = &profile->levels[i];
+        double sorted[e->end - e->start + 1];
+        unsigned m = 0;
+
+        l->capacity = i + 1 < n ? sizes[e->end] : sizes[e->start];
+        l->ways = 0;
+        l->ns = INFINITY;
+        for (unsigned s = e->start; s <= e->end; s++) {
+            if (ns[s] < l->ns) l->ns = ns[s];
+
+            unsigned k = m++;
+            while (k && sorted[k - 1] > mbs[s]) sorted[k] = sorted[k - 1], k--;
+            sorted[k] = mbs[s];
+        }
+
+        l->mb_per_sec = sorted[m / 2];
+    }
+}
+
+// a chase over k same-set lines slows down once k exceeds the ways of each level in turn,
+// so level i's ways is the k before the i-th step, lines capacity apart only share a set if the set
+// bits survive translation, true of L1 (its sets fit in a 4K page so it can index before the TLB) and
+// of levels up to a huge page when base is on them, the rest are left at 0 for unknown
+static void estimate_ways(
+    struct mountain_profile *profile, struct mountain_bench_params const params,
+    volatile char *base, uint64_t span, bool huge
+) {
+    for (unsigned l = 0; l + 1 < profile->nlevels; l++) {
+        uint64_t const spacing = profile->levels[l].capacity;
+        if (l && !(huge && spacing <= HUGE_PAGE_SIZE)) continue;
+
+        unsigned const kmax = span / spacing < MAX_WAYS + 1 ? span / spacing : MAX_WAYS + 1;
+        unsigned steps = 0;
+        double floor = mountain_chase_ns(params, mountain_conflict_chain(base, 1, spacing), 1);
+
+        for (unsigned k = 2; k <= kmax; k++) {
+            double const t = mountain_chase_ns(params, mountain_conflict_chain(base, k, spacing), k);
+
+            if (debug("ways"))
+                fprintf(stderr, "level %u, spacing %"PRIu64", k = %u: %.2f ns\n", l, spacing, k, t);
+
+            if (t <= floor * CLIFF_RATIO) {
+                if (t < floor) floor = t;
+                continue;
+            }
+
+            if (++steps == l + 1) {
+                profile->levels[l].ways = k - 1;
+                break;
+            }
+
+            floor = t;
+        }
+    }
+}
+
+// a random chase over 4K pages misses the TLB well before it misses L2 and lands on whatever physical
+// pages it was given, so capacities come out as TLB reach and shift from run to run, collapse the whole
+// huge pages at the start of an already written buf onto huge pages, false if buf isn't aligned for them
+static bool huge_pages(volatile char *buf, uint64_t bytes) {
+    uint64_t const huge = bytes / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+
+    if ((uintptr_t) buf % HUGE_PAGE_SIZE || !huge) return false;
+
+    if (madvise((void *) buf, huge, MADV_HUGEPAGE) || madvise((void *) buf, huge, MADV_COLLAPSE)) {
+        if (debug("huge_pages")) perror("madvise");
+        return false;
+    }
+
+    return true;
+}
+
+// random chase latency at each size, order needs room for one entry per line of the largest size,
+// and at least one, sizes under a line get a single node
+static void latencies(
+    double *ns, uint64_t const *sizes, unsigned n,
+    struct mountain_bench_params const params, volatile char *base, uint64_t *order
+) {
+    for (unsigned i = 0; i < n; i++) {
+        uint64_t const nodes = sizes[i] < LINE_SIZE ? 1 : sizes[i] / LINE_SIZE;
+        ns[i] = mountain_chase_ns(params, mountain_random_chain(base, nodes, order), nodes);
+
+        if (debug("latency"))
+            fprintf(stderr, "latency at %"PRIu64" bytes: %.2f ns\n", sizes[i], ns[i]);
+    }
+}
+
+bool mountain_analyze(
+    struct mountain_grid *g, struct mountain_sweep const *s,
+    volatile char *base, uint64_t span, struct mountain_profile *profile
+) {
+    size_t const elsz = mountain_element_size(s->kernel);
+
+    struct mountain_read_args fargs = { .data = base, .n = 0, .stride = 1 };
+    g->overhead = mountain_bench(s->params, mountain_kernels[s->kernel], &fargs);
+
+    uint64_t *order = malloc((g->sizes[g->nsizes - 1] / LINE_SIZE + 1) * sizeof *order);
+    if (!order) {
+        fprintf(stderr, "chain allocation failed\n");
+        return false;
+    }
+
+    double ns[g->nsizes], mbs[g->nsizes];
+    bool const huge = huge_pages(base, span);
+    if (!huge && span >= HUGE_PAGE_SIZE)
+        fprintf(stderr, "analyze buffer isn't on huge pages, capacities may be TLB reach\n");
+
+    latencies(ns, g->sizes, g->nsizes, s->params, base, order);
+    free(order);
+
+    for (unsigned i = 0; i < g->nsizes; i++) mbs[i] = mb_per_sec(g, i, 0);
+
+    struct level_estimate levels[MAX_CACHE_LEVELS + 1];
+    unsigned const n = find_levels(levels, MAX_CACHE_LEVELS + 1, ns, g->nsizes);
+    level_stats(profile, levels, n, g->sizes, ns, mbs);
+    profile->line_size = estimate_line_size(g, elsz, levels, n);
+    estimate_ways(profile, s->params, base, span, huge);
+
+    return true;
+}
+
+// few samples per point, the steps between levels are much bigger than the noise this lets through
+static struct mountain_bench_params const quick_params = {
+    .prime_cache = true,
+    .timer = MOUNTAIN_CLOCK,
+    .k = 3,
+    .max_samples = 10,
+    .shift_samples = 0,
+    .denom = 20,
+    .base_spread = 2
+};
+
+#define QUICK_MIN_SIZE_P2 12
+#define QUICK_MAX_SIZE_P2 26
+bool mountain_quick_profile(struct mountain_profile *profile) {
+    uint64_t const start = mountain_now(MOUNTAIN_CLOCK);
+    unsigned const n = QUICK_MAX_SIZE_P2 - QUICK_MIN_SIZE_P2 + 1;
+    uint64_t const bytes = UINT64_C(1) << QUICK_MAX_SIZE_P2;
+
+    void *buf = NULL;
+    uint64_t *order = malloc(bytes / LINE_SIZE * sizeof *order);
+    if (!order || posix_memalign(&buf, HUGE_PAGE_SIZE, bytes) || !mountain_prepare(buf, bytes, 0xa5, false)) {
+        fprintf(stderr, "quick profile allocation failed\n");
+        return free(order), free(buf), false;
+    }
+
+    if (!huge_pages(buf, bytes) && debug("quick_profile"))
+        fprintf(stderr, "quick profile buffer isn't on huge pages\n");
+
+    uint64_t sizes[n];
+    double ns[n], mbs[n];
+    for (unsigned i = 0; i < n; i++) {
+        sizes[i] = UINT64_C(1) << (QUICK_MIN_SIZE_P2 + i);
+
+        // scalar loads are bound by how fast the loop issues them, not by the level, avx2 reads aren't
+        struct mountain_read_args fargs = { .data = buf, .n = sizes[i] / sizeof (__m256i), .stride = 1 };
+        mbs[i] = sizes[i] * 1000.0 / mountain_bench(quick_params, mountain_kernels[MOUNTAIN_AVX2], &fargs);
+    }
+
+    latencies(ns, sizes, n, quick_params, buf, order);
+    free(order);
+    free(buf);
+
+    struct level_estimate levels[MAX_CACHE_LEVELS + 1];
+    level_stats(profile, levels, find_levels(levels, MAX_CACHE_LEVELS + 1, ns, n), sizes, ns, mbs);
+
+    struct mountain_cache_level cpuid[MAX_CACHE_LEVELS];
+    profile->line_size = mountain_cache_levels(cpuid, MAX_CACHE_LEVELS) ? cpuid[0].line_size : LINE_SIZE;
+
+    if (debug("quick_profile"))
+        fprintf(stderr, "quick profile took %"PRIu64" ns\n", mountain_now(MOUNTAIN_CLOCK) - start);
+
+    return true;
+}
@@ -1,14 +1,25 @@
+#define _GNU_SOURCE
+#include "mountain.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <inttypes.h>
 #include <stdbool.h>
 #include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
 #include <time.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <x86intrin.h>
-#include <cpuid.h>
 
 #define MAX_FLAG 128
+#define NO_CPU UINT16_MAX
+#define ONE_SEC_NS 1000000000
 
 enum arg_type {
     UNKNOWN_ARG,
@@ -26,55 +37,104 @@ enum arg_type {
     PRIME_CACHE,
     USE_RDTSC,
     THROUGHPUT,
-    BENCHMARK
+    BENCHMARK,
+    OFFSET,
+    OFFSET_STEP,
+    ALIGN_SWEEP,
+    ALIAS_SWEEP,
+    ANALYZE,
+    MONITOR,
+    DUTY,
+    ROUNDS,
+    OUTPUT,
+    SOCKET,
+    ROTATE,
+    SMT,
+    CPU,
+    SIBLING,
+    ANTAGONIST,
+    FILL,
+    MLOCK,
+    FLUSH,
+    QUICK_PROFILE,
+    DISTRIBUTION,
+    STREAMS_SWEEP,
+    CHAINS_SWEEP,
+    ENERGY,
+    RAPL_ROOT,
+    THREADS,
+    CONTENTION
 };
 
 enum benchmark {
-    UINT64,
-    UINT64_SINK,        // TODO: use perf counters to determine if this is needed
-    AVX2,
-    AVX2_SINK,
+    UINT64 = MOUNTAIN_UINT64,
+    UINT64_SINK = MOUNTAIN_UINT64_SINK,     // TODO: use perf counters to determine if this is needed
+    AVX2 = MOUNTAIN_AVX2,
+    AVX2_SINK = MOUNTAIN_AVX2_SINK,
+    FETCH_ADD = MOUNTAIN_FETCH_ADD,
+    CAS = MOUNTAIN_CAS,
+    XCHG = MOUNTAIN_XCHG,
     L1_MAX,
     L2_MAX,
     L3_MAX
 };
 
+enum sweep {
+    MOUNTAIN,           // (stride, size) grid
+    ALIGN,              // (base offset, size) grid with offset=[0,63], reads split cache lines
+    ALIAS,              // (page offset, size) grid between a read and a write stream, 4K aliasing
+    STREAMS,            // (streams, size) grid of concurrent sequential streams
+    CHAINS              // (chains, size) grid of interleaved pointer chases
+};
+
+enum antagonist {
+    IDLE,
+    STREAM,
+    CHASE,
+    SPIN,
+    ALL_ANTAGONISTS
+};
+
 struct arg {
     enum arg_type type;
     char flag[MAX_FLAG];
     union {
         uint8_t u8;
-        char *s;
+        uint16_t u16;
+        uint64_t u64;
+        char const *s;
         enum benchmark b;
+        enum antagonist a;
+        enum mountain_contention c;
     };
 };
 
 struct args {
-    uint8_t stride_interval, // interval=[1,n] where interval divides max_stride
-            start_stride,    // stride=[1,n] where start < end
-            end_stride,
-            min_size_p2,     // size=2^n where n=[10,27] and min_size < max_size
+    uint64_t stride_interval, // interval=[1,n] where interval divides max_stride
+             start_stride,    // stride=[1,n] where start < end
+             end_stride;
+    uint8_t min_size_p2,     // size=2^n where n=[10,40] and min_size < max_size
             max_size_p2,
-            shift_samples;
-    bool prime_cache, use_rdtsc, throughput;
+            shift_samples,
+            offset_step,     // step=[1,n] for the align and alias sweeps
+            max_streams,     // streams=[1,32] for the stream and chain sweeps
+            threads;         // threads=[1,64] running each mountain point
+    uint16_t offset,         // offset=[0,4095] bytes from the page aligned start of the buffer
+             monitor,        // seconds between monitoring rounds, 0 to sweep once
+             rounds,         // monitoring rounds, 0 to run until killed
+             rotate_mb,      // rotate the output file once it reaches this size
+             cpu,            // cpu to measure on in smt mode
+             sibling;        // cpu to run the antagonist on, NO_CPU to find cpu's SMT sibling
+    uint8_t duty,            // duty=[1,100] percent of one cpu the monitor may use
+            fill;            // fill=[1,255] byte written over the whole buffer before sweeping
+    char const *output, *socket, *rapl_root;
+    bool prime_cache, use_rdtsc, throughput, analyze, smt, mlock, flush, quick_profile, distribution, energy;
     enum benchmark benchmark;
+    enum antagonist antagonist;
+    enum mountain_contention contention;
+    enum sweep sweep;
 };
 
-struct bench_params {
-    bool prime_cache, use_rdtsc;
-    uint8_t k;
-    unsigned
-        max_samples,
-        shift_samples,
-        denom,
-        base_spread;
-};
-
-static bool debug(char const *key) {
-    char *dbg = getenv("DEBUG");
-    return dbg != NULL && ((key && !strcmp(key, dbg)) || !strcmp("*", dbg));
-}
-
 static void uint8_val(char const *s, struct arg *arg) {
     char *end = NULL;
     long n = strtol(s, &end, 10);
@@ -94,11 +154,57 @@ static void uint8_val(char const *s, struct arg *arg) {
     arg->u8 = (uint8_t) n;
 }
 
+static void uint16_val(char const *s, struct arg *arg) {
+    char *end = NULL;
+    long n = strtol(s, &end, 10);
+
+    if (s == end) {
+        arg->type = INVALID_VAL;
+        fprintf(stderr, "parse error on value %s of flag %s\n", s, arg->flag);
+        return;
+    }
+
+    if (n < 0 || n > UINT16_MAX) {
+        arg->type = INVALID_VAL;
+        fprintf(stderr, "value %s for flag %s out of expected range: [0,65535]\n", s, arg->flag);
+        return;
+    }
+
+    arg->u16 = (uint16_t) n;
+}
+
+static void uint64_val(char const *s, struct arg *arg) {
+    char *end = NULL;
+    errno = 0;
+    unsigned long long n = strtoull(s, &end, 10);
+
+    if (s == end || *s == '-') {
+        arg->type = INVALID_VAL;
+        fprintf(stderr, "parse error on value %s of flag %s\n", s, arg->flag);
+        return;
+    }
+
+    if (errno == ERANGE) {
+        arg->type = INVALID_VAL;
+        fprintf(stderr, "value %s for flag %s out of expected range: [0,%"PRIu64"]\n", s, arg->flag, UINT64_MAX);
+        return;
+    }
+
+    arg->u64 = (uint64_t) n;
+}
+
+static void string_val(char const *s, struct arg *arg) {
+    arg->s = s;
+}
+
 static void benchmark_val(char const *s, struct arg *arg) {
     if (!strcmp(s, "uint64"))           arg->b = UINT64;
     else if (!strcmp(s, "uint64_sink")) arg->b = UINT64_SINK;
     else if (!strcmp(s, "avx2"))        arg->b = AVX2;
     else if (!strcmp(s, "avx2_sink"))   arg->b = AVX2_SINK;
+    else if (!strcmp(s, "fetch_add"))   arg->b = FETCH_ADD;
+    else if (!strcmp(s, "cas"))         arg->b = CAS;
+    else if (!strcmp(s, "xchg"))        arg->b = XCHG;
     else if (!strcmp(s, "l1_max"))      arg->b = L1_MAX;
     else if (!strcmp(s, "l2_max"))      arg->b = L2_MAX;
     else if (!strcmp(s, "l3_max"))      arg->b = L3_MAX;
@@ -108,6 +214,28 @@ static void benchmark_val(char const *s, struct arg *arg) {
     }
 }
 
+static void contention_val(char const *s, struct arg *arg) {
+    if (!strcmp(s, "line"))          arg->c = MOUNTAIN_LINE;
+    else if (!strcmp(s, "false"))    arg->c = MOUNTAIN_FALSE_SHARING;
+    else if (!strcmp(s, "disjoint")) arg->c = MOUNTAIN_DISJOINT;
+    else {
+        arg->type = INVALID_VAL;
+        fprintf(stderr, "%s is not a known contention\n", s);
+    }
+}
+
+static void antagonist_val(char const *s, struct arg *arg) {
+    if (!strcmp(s, "idle"))        arg->a = IDLE;
+    else if (!strcmp(s, "stream")) arg->a = STREAM;
+    else if (!strcmp(s, "chase"))  arg->a = CHASE;
+    else if (!strcmp(s, "spin"))   arg->a = SPIN;
+    else if (!strcmp(s, "all"))    arg->a = ALL_ANTAGONISTS;
+    else {
+        arg->type = INVALID_VAL;
+        fprintf(stderr, "%s is not a known antagonist\n", s);
+    }
+}
+
 static void setflag(char *flag, char const *s, char const *e) {
     size_t const n = e - s < MAX_FLAG ? e - s : MAX_FLAG - 1;
     strncpy(flag, s, n);
@@ -171,16 +299,42 @@ static void print_usage(FILE *handle, char const *prog) {
     fprintf(handle, "usage: %s [options]\n\n", prog);
     fprintf(handle, "Generate a memory mountain\n\n");
     fprintf(handle, "options:\n");
-    fprintf(handle, optfmt, "-b", "Benchmark: uint64 (default), uint64_sink, avx2, avx2_sink, l1_max, l2_max, l3_max");
+    fprintf(handle, optfmt, "-b", "Benchmark: uint64 (default), uint64_sink, avx2, avx2_sink, fetch_add, cas, xchg, l1_max, l2_max, l3_max");
     fprintf(handle, optfmt, "-n, --stride-interval", "Interval to increase the stride by (+= 2).");
     fprintf(handle, optfmt, "-s, --start-stride", "Starting stride (1).");
     fprintf(handle, optfmt, "-e, --end-stride", "Ending stride (32).");
     fprintf(handle, optfmt, "-i, --min-size", "Minimum size as a power of two (2^n where n = 10 or 1 KB).");
-    fprintf(handle, optfmt, "-a, --max-size", "Maximum size as a power of two (2^n where n = 27 or 128 MB).");
+    fprintf(handle, optfmt, "-a, --max-size", "Maximum size as a power of two up to 2^40 (2^n where n = 27 or 128 MB).");
     fprintf(handle, optfmt, "--shift-samples", "Shift off the minimum sample after N samples (50).");
     fprintf(handle, optfmt, "--prime-cache", "Attempt to prime the cache before entering the test loop.");
     fprintf(handle, optfmt, "-t", "Use rdtsc for tracking time (does not work for _max benchmarks).");
     fprintf(handle, optfmt, "-p", "Output as throughput measured in MB/s instead of (stride, size, time) points");
+    fprintf(handle, optfmt, "--offset", "Offset of the data from the page aligned buffer in bytes (0).");
+    fprintf(handle, optfmt, "--align-sweep", "Sweep the base offset over [0,63] bytes, output (offset, size, time, penalty %) points.");
+    fprintf(handle, optfmt, "--alias-sweep", "Sweep the page offset of a write stream, output (page offset, size, time, penalty %) points.");
+    fprintf(handle, optfmt, "--offset-step", "Bytes to increase the align sweep offset by (4).");
+    fprintf(handle, optfmt, "--streams", "Sweep 1 to N concurrent streams, output (streams, size, time, MB/s, speedup) points.");
+    fprintf(handle, optfmt, "--chains", "Sweep 1 to N interleaved pointer chases, output (chains, size, time, M loads/s, speedup) points.");
+    fprintf(handle, optfmt, "--threads", "Threads running each mountain point at once, the first is timed (1).");
+    fprintf(handle, optfmt, "--contention", "What the threads share: line (one line for the atomics), false (sharing, up to 8 threads), disjoint (default)");
+    fprintf(handle, optfmt, "--energy", "Add MB/s and package and DRAM nJ/byte from RAPL to each mountain point.");
+    fprintf(handle, optfmt, "--rapl-root", "Directory to find the RAPL powercap zones in (/sys/class/powercap).");
+    fprintf(handle, optfmt, "--analyze", "Infer the cache hierarchy from the mountain and check it against cpuid, the line size needs strides from 1 stepping by less than a line (-b uint64).");
+    fprintf(handle, optfmt, "--monitor", "Probe each cache level and memory every N seconds, output (time, level, size, MB/s, ns) points.");
+    fprintf(handle, optfmt, "--duty", "Percent of one cpu the monitor may use, stretches the interval if needed (1).");
+    fprintf(handle, optfmt, "--rounds", "Stop monitoring after N rounds (0, run until killed).");
+    fprintf(handle, optfmt, "-o, --output", "Append monitor points to a file instead of stdout.");
+    fprintf(handle, optfmt, "--rotate", "Rotate the output file to <file>.1 once it reaches N MB (16).");
+    fprintf(handle, optfmt, "--socket", "Stream monitor points to a unix socket instead of stdout.");
+    fprintf(handle, optfmt, "--smt", "Generate a mountain per antagonist running on the measuring cpu's SMT sibling.");
+    fprintf(handle, optfmt, "--cpu", "Cpu to measure on in smt mode (0).");
+    fprintf(handle, optfmt, "--sibling", "Cpu to run the antagonist on (the SMT sibling of --cpu).");
+    fprintf(handle, optfmt, "--antagonist", "Antagonist: idle, stream, chase, spin, all (default)");
+    fprintf(handle, optfmt, "--fill", "Byte to fill the buffer with before sweeping, non-zero so no page maps the zero page (165).");
+    fprintf(handle, optfmt, "--mlock", "Lock the buffer into memory before sweeping.");
+    fprintf(handle, optfmt, "--flush", "Flush each point's data from the caches before every sample, measuring it cold.");
+    fprintf(handle, optfmt, "--quick-profile", "Print a coarse cache profile in under a second and exit.");
+    fprintf(handle, optfmt, "--distribution", "Record every sample, add min, p50, p90, p99, max and a histogram to each point.");
     fprintf(handle, "\n");
 }
 
@@ -203,15 +357,41 @@ static char const **parse_arg(struct arg *arg, char const **argv) {
        _parse_arg("help", 'h', HELP, NULL, arg, &argv)
     || _parse_arg("version", 'v', VERSION, NULL, arg, &argv)
     || _parse_arg(NULL, 'b', BENCHMARK, benchmark_val, arg, &argv)
-    || _parse_arg("stride-interval", 'n', STRIDE_INTERVAL, uint8_val, arg, &argv)
-    || _parse_arg("start-stride", 's', START_STRIDE, uint8_val, arg, &argv)
-    || _parse_arg("end-stride", 'e', END_STRIDE, uint8_val, arg, &argv)
+    || _parse_arg("stride-interval", 'n', STRIDE_INTERVAL, uint64_val, arg, &argv)
+    || _parse_arg("start-stride", 's', START_STRIDE, uint64_val, arg, &argv)
+    || _parse_arg("end-stride", 'e', END_STRIDE, uint64_val, arg, &argv)
     || _parse_arg("min-size", 'i', MIN_SIZE, uint8_val, arg, &argv)
     || _parse_arg("max-size", 'a', MAX_SIZE, uint8_val, arg, &argv)
     || _parse_arg("shift-samples", 0, SHIFT_SAMPLES, uint8_val, arg, &argv)
     || _parse_arg("prime-cache", 0, PRIME_CACHE, NULL, arg, &argv)
     || _parse_arg(NULL, 't', USE_RDTSC, NULL, arg, &argv)
     || _parse_arg(NULL, 'p', THROUGHPUT, NULL, arg, &argv)
+    || _parse_arg("offset", 0, OFFSET, uint16_val, arg, &argv)
+    || _parse_arg("offset-step", 0, OFFSET_STEP, uint8_val, arg, &argv)
+    || _parse_arg("align-sweep", 0, ALIGN_SWEEP, NULL, arg, &argv)
+    || _parse_arg("alias-sweep", 0, ALIAS_SWEEP, NULL, arg, &argv)
+    || _parse_arg("streams", 0, STREAMS_SWEEP, uint8_val, arg, &argv)
+    || _parse_arg("chains", 0, CHAINS_SWEEP, uint8_val, arg, &argv)
+    || _parse_arg("energy", 0, ENERGY, NULL, arg, &argv)
+    || _parse_arg("threads", 0, THREADS, uint8_val, arg, &argv)
+    || _parse_arg("contention", 0, CONTENTION, contention_val, arg, &argv)
+    || _parse_arg("rapl-root", 0, RAPL_ROOT, string_val, arg, &argv)
+    || _parse_arg("analyze", 0, ANALYZE, NULL, arg, &argv)
+    || _parse_arg("monitor", 0, MONITOR, uint16_val, arg, &argv)
+    || _parse_arg("duty", 0, DUTY, uint8_val, arg, &argv)
+    || _parse_arg("rounds", 0, ROUNDS, uint16_val, arg, &argv)
+    || _parse_arg("output", 'o', OUTPUT, string_val, arg, &argv)
+    || _parse_arg("rotate", 0, ROTATE, uint16_val, arg, &argv)
+    || _parse_arg("socket", 0, SOCKET, string_val, arg, &argv)
+    || _parse_arg("smt", 0, SMT, NULL, arg, &argv)
+    || _parse_arg("cpu", 0, CPU, uint16_val, arg, &argv)
+    || _parse_arg("sibling", 0, SIBLING, uint16_val, arg, &argv)
+    || _parse_arg("antagonist", 0, ANTAGONIST, antagonist_val, arg, &argv)
+    || _parse_arg("fill", 0, FILL, uint8_val, arg, &argv)
+    || _parse_arg("mlock", 0, MLOCK, NULL, arg, &argv)
+    || _parse_arg("flush", 0, FLUSH, NULL, arg, &argv)
+    || _parse_arg("quick-profile", 0, QUICK_PROFILE, NULL, arg, &argv)
+    || _parse_arg("distribution", 0, DISTRIBUTION, NULL, arg, &argv)
     ;
 
     // copy flag
@@ -236,15 +416,41 @@ static bool parse_args(struct args *args, char const *version, char const **argv
 
         switch (arg.type) {
             case BENCHMARK:         args->benchmark = arg.b; break;
-            case STRIDE_INTERVAL:   args->stride_interval = arg.u8; break;
-            case START_STRIDE:      args->start_stride = arg.u8; break;
-            case END_STRIDE:        args->end_stride = arg.u8; break;
+            case STRIDE_INTERVAL:   args->stride_interval = arg.u64; break;
+            case START_STRIDE:      args->start_stride = arg.u64; break;
+            case END_STRIDE:        args->end_stride = arg.u64; break;
             case MIN_SIZE:          args->min_size_p2 = arg.u8; break;
             case MAX_SIZE:          args->max_size_p2 = arg.u8; break;
             case SHIFT_SAMPLES:     args->shift_samples = arg.u8; break;
             case PRIME_CACHE:       args->prime_cache = true; break;
             case USE_RDTSC:         args->use_rdtsc = true; break;
             case THROUGHPUT:        args->throughput = true; break;
+            case OFFSET:            args->offset = arg.u16; break;
+            case OFFSET_STEP:       args->offset_step = arg.u8; break;
+            case ALIGN_SWEEP:       args->sweep = ALIGN; break;
+            case ALIAS_SWEEP:       args->sweep = ALIAS; break;
+            case STREAMS_SWEEP:     args->sweep = STREAMS, args->max_streams = arg.u8; break;
+            case CHAINS_SWEEP:      args->sweep = CHAINS, args->max_streams = arg.u8; break;
+            case ENERGY:            args->energy = true; break;
+            case RAPL_ROOT:         args->rapl_root = arg.s; break;
+            case THREADS:           args->threads = arg.u8; break;
+            case CONTENTION:        args->contention = arg.c; break;
+            case ANALYZE:           args->analyze = true; break;
+            case MONITOR:           args->monitor = arg.u16; break;
+            case DUTY:              args->duty = arg.u8; break;
+            case ROUNDS:            args->rounds = arg.u16; break;
+            case OUTPUT:            args->output = arg.s; break;
+            case ROTATE:            args->rotate_mb = arg.u16; break;
+            case SOCKET:            args->socket = arg.s; break;
+            case SMT:               args->smt = true; break;
+            case CPU:               args->cpu = arg.u16; break;
+            case SIBLING:           args->sibling = arg.u16; break;
+            case ANTAGONIST:        args->antagonist = arg.a; break;
+            case FILL:              args->fill = arg.u8; break;
+            case MLOCK:             args->mlock = true; break;
+            case FLUSH:             args->flush = true; break;
+            case QUICK_PROFILE:     args->quick_profile = true; break;
+            case DISTRIBUTION:      args->distribution = true; break;
             case VERSION:
                 print_version(stdout, version);
                 exit(0);
@@ -281,64 +487,140 @@ static bool parse_args(struct args *args, char const *version, char const **argv
 static void debug_args(struct args const *args) {
     fprintf(stderr, "args:\n");
     fprintf(stderr,
-        "  stride_interval = %hhu\n"
-        "  start_stride = %hhu\n"
-        "  end_stride = %hhu\n"
+        "  stride_interval = %"PRIu64"\n"
+        "  start_stride = %"PRIu64"\n"
+        "  end_stride = %"PRIu64"\n"
         "  min_size_p2 = %hhu\n"
         "  max_size_p2 = %hhu\n"
         "  shift_samples = %hhu\n"
+        "  offset = %hu\n"
+        "  offset_step = %hhu\n"
+        "  max_streams = %hhu\n"
+        "  threads = %hhu\n"
+        "  contention = %d\n"
+        "  sweep = %d\n"
         "  prime_cache = %s\n"
         "  use_rdtsc = %s\n"
-        "  throughput = %s\n",
+        "  throughput = %s\n"
+        "  analyze = %s\n"
+        "  monitor = %hu\n"
+        "  duty = %hhu\n"
+        "  rounds = %hu\n"
+        "  output = %s\n"
+        "  rotate_mb = %hu\n"
+        "  socket = %s\n"
+        "  smt = %s\n"
+        "  cpu = %hu\n"
+        "  sibling = %hu\n"
+        "  antagonist = %d\n"
+        "  fill = %hhu\n"
+        "  mlock = %s\n"
+        "  flush = %s\n"
+        "  quick_profile = %s\n"
+        "  distribution = %s\n"
+        "  energy = %s\n"
+        "  rapl_root = %s\n",
         args->stride_interval,
         args->start_stride,
         args->end_stride,
         args->min_size_p2,
         args->max_size_p2,
         args->shift_samples,
+        args->offset,
+        args->offset_step,
+        args->max_streams,
+        args->threads,
+        args->contention,
+        args->sweep,
         args->prime_cache ? "true" : "false",
         args->use_rdtsc ? "true" : "false",
-        args->throughput ? "true" : "false");
+        args->throughput ? "true" : "false",
+        args->analyze ? "true" : "false",
+        args->monitor,
+        args->duty,
+        args->rounds,
+        args->output ? args->output : "(stdout)",
+        args->rotate_mb,
+        args->socket ? args->socket : "(none)",
+        args->smt ? "true" : "false",
+        args->cpu,
+        args->sibling,
+        args->antagonist,
+        args->fill,
+        args->mlock ? "true" : "false",
+        args->flush ? "true" : "false",
+        args->quick_profile ? "true" : "false",
+        args->distribution ? "true" : "false",
+        args->energy ? "true" : "false",
+        args->rapl_root ? args->rapl_root : "(default)");
 }
 
-#define MAX_POWER 32
-#define SIZE_FMT "%s size cannot be greater than %ld bytes, choose a power smaller than %d.\n"
+#define MAX_POWER 40
+#define MAX_STRIDES 1024
+#define SIZE_FMT "%s size cannot be greater than %"PRIu64" bytes, choose a power smaller than %d.\n"
 static bool validate_args(struct args const *args) {
     bool success = true;
     if (args->min_size_p2 > MAX_POWER)
-        success = false, fprintf(stderr, SIZE_FMT, "minimum", 1L << MAX_POWER, MAX_POWER);
+        success = false, fprintf(stderr, SIZE_FMT, "minimum", UINT64_C(1) << MAX_POWER, MAX_POWER);
     if (args->max_size_p2 > MAX_POWER)
-        success = false, fprintf(stderr, SIZE_FMT, "maximum", 1L << MAX_POWER, MAX_POWER);
+        success = false, fprintf(stderr, SIZE_FMT, "maximum", UINT64_C(1) << MAX_POWER, MAX_POWER);
+    if (!args->start_stride || !args->stride_interval)
+        success = false, fprintf(stderr, "start stride and stride interval must be greater than zero\n");
+    else if (args->start_stride <= args->end_stride
+        && (args->end_stride - args->start_stride) / args->stride_interval >= MAX_STRIDES)
+        success = false, fprintf(stderr, "at most %d strides per sweep, increase the stride interval\n", MAX_STRIDES);
     if (args->start_stride > args->end_stride)
         success = false, fprintf(stderr, "start stride must be less than or equal to ending stride\n");
     if (args->min_size_p2 > args->max_size_p2)
         success = false, fprintf(stderr, "max size must be greater than or equal to min size\n");
+    if (args->offset >= MOUNTAIN_PAGE_SIZE)
+        success = false, fprintf(stderr, "offset must be less than %d bytes\n", MOUNTAIN_PAGE_SIZE);
+    if (!args->offset_step)
+        success = false, fprintf(stderr, "offset step must be greater than zero\n");
+    if (args->sweep != MOUNTAIN && args->benchmark >= L1_MAX)
+        success = false, fprintf(stderr, "the offset and stream sweeps do not support _max benchmarks\n");
+    if (!args->max_streams || args->max_streams > MOUNTAIN_MAX_STREAMS)
+        success = false, fprintf(stderr, "streams and chains must be in [1,%d]\n", MOUNTAIN_MAX_STREAMS);
+    if (args->analyze && (args->sweep != MOUNTAIN || args->benchmark >= L1_MAX))
+        success = false, fprintf(stderr, "analyze requires a mountain sweep\n");
+    if (args->analyze && args->min_size_p2 < 6)
+        success = false, fprintf(stderr, "analyze requires sizes of at least one cache line, a min size of 6 or more\n");
+    if (!args->duty || args->duty > 100)
+        success = false, fprintf(stderr, "duty must be a percentage in [1,100]\n");
+    if (!args->rotate_mb)
+        success = false, fprintf(stderr, "rotate size must be greater than zero\n");
+    if (args->output && args->socket)
+        success = false, fprintf(stderr, "choose either an output file or a socket\n");
+    if (args->smt && (args->sweep != MOUNTAIN || args->benchmark >= L1_MAX || args->analyze))
+        success = false, fprintf(stderr, "smt mode requires a mountain sweep without --analyze\n");
+    if (!args->fill)
+        success = false, fprintf(stderr, "fill must be non-zero\n");
+    if (args->distribution && (args->benchmark >= L1_MAX || args->monitor))
+        success = false, fprintf(stderr, "distribution requires a mountain, align or alias sweep\n");
+    if (args->energy && (args->sweep != MOUNTAIN || args->benchmark >= L1_MAX || args->monitor))
+        success = false, fprintf(stderr, "energy requires a mountain sweep\n");
+    if (args->energy && args->flush)
+        success = false, fprintf(stderr, "energy is measured back to back, so it can't be used with flush\n");
+    if (args->benchmark >= FETCH_ADD && args->benchmark <= XCHG && args->offset % sizeof (uint64_t))
+        success = false, fprintf(stderr, "the atomic benchmarks need an offset that's a multiple of 8\n");
+    if (args->benchmark >= FETCH_ADD && args->benchmark <= XCHG && (args->sweep == ALIGN || args->sweep == ALIAS))
+        success = false, fprintf(stderr, "the atomic benchmarks do not support the align and alias sweeps\n");
+    if (!args->threads || args->threads > MOUNTAIN_MAX_THREADS)
+        success = false, fprintf(stderr, "threads must be in [1,%d]\n", MOUNTAIN_MAX_THREADS);
+    if (args->energy && args->threads > 1)
+        success = false, fprintf(stderr, "energy is measured on one thread, so it can't be used with threads\n");
+    if (args->threads > 1 && (args->sweep != MOUNTAIN || args->benchmark >= L1_MAX || args->smt || args->monitor))
+        success = false, fprintf(stderr, "threads require a mountain sweep without --smt\n");
+    if (args->contention == MOUNTAIN_FALSE_SHARING && args->threads > MOUNTAIN_LINE_SIZE / sizeof (uint64_t))
+        success = false, fprintf(stderr, "false sharing allows at most %zu threads, one per word of a line\n",
+            MOUNTAIN_LINE_SIZE / sizeof (uint64_t));
+    if (args->smt && args->sibling == args->cpu)
+        success = false, fprintf(stderr, "the antagonist must run on a different cpu\n");
 
     return success;
 }
 
-static uint64_t rdtsc() {
-    uint64_t tsc, lo;
-    asm volatile ("lfence\n\trdtsc\n\tlfence" : "=a" (lo), "=d" (tsc));
-    return (tsc << 32) | lo;
-}
-
-#define ONE_SEC_NS 1000000000
-static uint64_t now(bool const use_rdtsc) {
-    if (use_rdtsc) return rdtsc();
-
-    struct timespec ts;
-
-    // CLOCK_MONOTONIC on OSX only supports microsecond precision, and each nanosecond counts
-    if (clock_gettime(CLOCK_MONOTONIC_RAW, &ts)) {
-        fprintf(stderr, "error reading current time\n");
-        abort();
-    }
-
-    return ts.tv_sec * ONE_SEC_NS + ts.tv_nsec;
-}
-
-static void debug_bench_params(struct bench_params const *p) {
+static void debug_bench_params(struct mountain_bench_params const *p) {
     fprintf(stderr, "bench_params:\n");
     fprintf(stderr,
         "  prime_cache = %s\n"
@@ -347,209 +629,591 @@ static void debug_bench_params(struct bench_params const *p) {
         "  shift_samples = %u\n"
         "  denom = %u\n"
         "  base_spread = %u\n"
-        "  use_rdtsc = %s\n",
+        "  timer = %s\n"
+        "  flush_bytes = %"PRIu64"\n",
         p->prime_cache ? "true" : "false",
         p->k,
         p->max_samples,
         p->shift_samples,
         p->denom,
         p->base_spread,
-        p->use_rdtsc ? "true" : "false");
+        p->timer == MOUNTAIN_RDTSC ? "rdtsc" : "clock",
+        p->flush ? p->flush_bytes : 0);
 }
 
-static bool has_converged(uint64_t *samples, unsigned s, struct bench_params const p) {
-    uint64_t delta = samples[p.k - 1] - samples[0];
-    uint64_t spread = samples[0] / p.denom + p.base_spread;
+#define define_max(cache, size)                                                           \
+__attribute__((noinline))                                                                 \
+static void bench_##cache##_avx2(volatile __m256i *data, bool throughput) {               \
+    uint64_t const N = (size) / sizeof (__m256i);                                         \
+    for (uint64_t i = 0; i < N; i++) data[i];                                             \
+    _mm_lfence();                                                                         \
+                                                                                          \
+    uint64_t min_elapsed = UINT64_MAX;                                                    \
+                                                                                          \
+    for (int t = 0; t < 32; t++) {                                                        \
+        enum mountain_timer const timer = MOUNTAIN_RDTSC;                                 \
+        uint64_t start = mountain_now(timer);                                             \
+                                                                                          \
+        _Pragma("unroll")                                                                 \
+        for (uint64_t i = 0; i < N; i++) data[i];                                         \
+        _mm_lfence();                                                                     \
+                                                                                          \
+        uint64_t elapsed = mountain_now(timer) - start;                                   \
+        if (timer == MOUNTAIN_RDTSC) elapsed = mountain_cycles_to_ns(elapsed);            \
+                                                                                          \
+        if (elapsed < min_elapsed) min_elapsed = elapsed;                                 \
+    }                                                                                     \
+                                                                                          \
+    if (throughput) printf("%"PRIu64" MB/s\n", (size) * UINT64_C(1000) / min_elapsed);    \
+    else            printf("%u %"PRIu64" %"PRIu64"\n", 1, (uint64_t) (size), min_elapsed);    \
+}
 
-    if (s >= p.k && debug("converging"))
-        fprintf(stderr, "converging... delta: %"PRIu64", spread: %"PRIu64"\n", delta, spread);
+define_max(l1, 1 << 15)
+// define_max(l2, 1 << 18)
+// define_max(l3, 1 << 23)
 
-    return s >= p.k && delta < spread;
+static char const *benchmark_str(enum benchmark b) {
+    switch (b) {
+        case L1_MAX: return "l1_max";
+        case L2_MAX: return "l2_max";
+        case L3_MAX: return "l3_max";
+        default:     return mountain_kernel_str((enum mountain_kernel) b);
+    }
 }
 
-static void sort_samples(uint64_t *samples, unsigned i) {
-    unsigned const k = i;
+// min p50 p90 p99 max, then the histogram as comma separated counts so that it stays one column
+static void print_distribution(struct mountain_point const *p) {
+    if (!p->samples) return;
 
-    while (i && samples[i - 1] > samples[i]) {
-        uint64_t t = samples[i - 1];
-        samples[i - 1] = samples[i];
-        samples[i] = t;
-        i--;
-    }
+    struct mountain_distribution d;
+    mountain_distribution(p->samples, p->nsamples, &d);
 
-    i = 0;
-    if (debug("sorted")) {
-        fprintf(stderr, "sorted samples (k = %u): [", k);
-        fprintf(stderr, "%"PRIu64"", samples[i++]);
-        while (i <= k)
-            fprintf(stderr, ", %"PRIu64"", samples[i++]);
+    printf(" %"PRIu64" %"PRIu64" %"PRIu64" %"PRIu64" %"PRIu64" %u", d.min, d.p50, d.p90, d.p99, d.max, d.hist[0]);
+    for (unsigned i = 1; i < MOUNTAIN_HIST_BUCKETS; i++) printf(",%u", d.hist[i]);
+
+    if (mountain_debug("samples")) {
+        fprintf(stderr, "samples at (%"PRIu64", %"PRIu64"): [", p->x, p->size);
+        for (unsigned i = 0; i < p->nsamples; i++) fprintf(stderr, i ? ", %"PRIu64 : "%"PRIu64, p->samples[i]);
         fprintf(stderr, "]\n");
     }
 }
 
-static unsigned add_sample(
-    uint64_t *samples, unsigned s, uint64_t elapsed,
-    struct bench_params const p
-) {
-    unsigned i = s < p.k ? s : p.k - 1U;
+// gnuplot data sets, a line per point and a blank line after each size,
+// energy is MB/s then package and dram nJ/byte, nan for what the machine doesn't report
+static void print_point(void *ctx, struct mountain_point const *p) { (void) ctx;
+    printf("%"PRIu64" %"PRIu64" %"PRIu64"", p->x, p->size, p->ns);
+    if (p->energy)
+        printf(" %.0f %.3f %.3f", p->size * 1000.0 / ((double) p->x * p->ns),
+            p->nj_per_byte[MOUNTAIN_PACKAGE], p->nj_per_byte[MOUNTAIN_DRAM]);
+    print_distribution(p);
+    printf("\n");
+}
 
-    if (s < p.k || elapsed < samples[i])
-        samples[i] = elapsed;
+static void print_offset_point(void *ctx, struct mountain_point const *p) { (void) ctx;
+    printf("%"PRIu64" %"PRIu64" %"PRIu64" %.2f", p->x, p->size, p->ns, p->penalty);
+    print_distribution(p);
+    printf("\n");
+}
 
-    return i;
+static void print_row(void *ctx, uint64_t size) { (void) ctx; (void) size;
+    printf("\n");
 }
 
-static void try_shift(uint64_t *samples, unsigned s, struct bench_params const p) {
-    if (s < p.k || s % p.shift_samples > 0) return;
+static struct mountain_callbacks const print_points = { print_point, print_row, NULL };
+static struct mountain_callbacks const print_offset_points = { print_offset_point, print_row, NULL };
 
-    unsigned i = 0;
-    while (i < p.k - 1U) samples[i] = samples[i + 1], i++;
-    samples[p.k - 1] = UINT64_MAX;  // add_sample will replace this
+// the rates of the current size in a stream or chain sweep, to find where they stop scaling
+struct scaling {
+    bool chains;
+    unsigned n;
+    double rates[MOUNTAIN_MAX_STREAMS];
+};
 
-    i = 0;
-    if (debug("shifts")) {
-        fprintf(stderr, "shifted: [");
-        fprintf(stderr, "%"PRIu64"", samples[i++]);
-        while (i <= p.k - 1U)
-            fprintf(stderr, ", %"PRIu64"", samples[i++]);
-        fprintf(stderr, "]\n");
+#define SCALING_RATIO 0.95  // within 5% of the best rate counts as no longer scaling
+
+// MB/s for streams, loads per microsecond for chains
+static void print_stream_point(void *ctx, struct mountain_point const *p) {
+    struct scaling *sc = ctx;
+    double const rate = p->loads * (sc->chains ? 1 : MOUNTAIN_LINE_SIZE) * 1000.0 / p->ns;
+    sc->rates[sc->n++] = rate;
+
+    printf("%"PRIu64" %"PRIu64" %"PRIu64" %.0f %.2f", p->x, p->size, p->ns, rate, rate / sc->rates[0]);
+    print_distribution(p);
+    printf("\n");
+}
+
+static void print_stream_row(void *ctx, uint64_t size) {
+    struct scaling *sc = ctx;
+    if (!sc->n) return;
+
+    double best = 0;
+    for (unsigned i = 0; i < sc->n; i++) if (sc->rates[i] > best) best = sc->rates[i];
+
+    unsigned knee = 0;
+    while (sc->rates[knee] < SCALING_RATIO * best) knee++;
+
+    char const *what = sc->chains ? "chain" : "stream";
+    printf("# %"PRIu64"K: scales to %u %ss, %.0f %s, %.2fx one %s\n\n",
+        size >> 10, knee + 1, what, sc->rates[knee], sc->chains ? "M loads/s" : "MB/s",
+        sc->rates[knee] / sc->rates[0], what);
+    sc->n = 0;
+}
+
+// points in the sweep, for sizing the sample arena
+static uint64_t sweep_points(struct args const *args, struct mountain_sweep const *sweep) {
+    unsigned per_size;
+    switch (args->sweep) {
+        default:
+        case MOUNTAIN: per_size = mountain_sweep_strides(sweep); break;
+        case ALIGN:    per_size = mountain_sweep_offset_count(sweep, MOUNTAIN_ALIGN); break;
+        case ALIAS:    per_size = mountain_sweep_offset_count(sweep, MOUNTAIN_ALIAS); break;
+        case STREAMS:
+        case CHAINS:   per_size = sweep->max_streams; break;
     }
+
+    return (uint64_t) mountain_sweep_sizes(sweep) * per_size;
 }
 
-// rdtsc ticks at a constant rate, regardless of actual CPU frequency
-// and so it can be converted to nanoseconds by using cpuid to get the CPU's base frequency
-#define PROC_FREQ_LEAF 0x16
-static uint64_t cycles_to_ns(uint64_t cycles) {
-    static unsigned freq = 0;
+static void print_penalties(struct mountain_penalty const *penalties, bool alias) {
+    struct mountain_cache_level levels[MOUNTAIN_MAX_LEVELS];
+    unsigned const nlevels = mountain_cache_levels(levels, MOUNTAIN_MAX_LEVELS);
+
+    for (unsigned i = 0; i <= nlevels; i++) {
+        struct mountain_penalty const *p = &penalties[i];
+        if (!p->n) continue;
 
-    if (!freq) {
-        unsigned b, c, d;
-        __get_cpuid(PROC_FREQ_LEAF, &freq, &b, &c, &d);
+        if (i < nlevels) printf("# L%u (%"PRIu64"K):", levels[i].level, levels[i].size >> 10);
+        else             printf("# memory:");
+        printf(" mean %s penalty %.2f%%, max %.2f%% at offset %u\n",
+            alias ? "aliasing" : "split", p->sum / p->n, p->max, p->max_offset);
+    }
+}
+
+static char const *check(bool ok) {
+    return ok ? "ok" : "MISMATCH";
+}
 
-        freq = freq / 100; // mhz to ghz * 10
+// the measured cache hierarchy, and whether it agrees with what cpuid says,
+// disagreements point at VMs or cache partitioning
+static void print_profile(struct mountain_profile const *profile, uint64_t max_size) {
+    struct mountain_cache_level cpuid[MOUNTAIN_MAX_LEVELS];
+    unsigned const ncpuid = mountain_cache_levels(cpuid, MOUNTAIN_MAX_LEVELS),
+                   n = profile->nlevels;
+
+    if (profile->line_size) {
+        unsigned const line = profile->line_size;
+        printf("# line size: %u bytes", line);
+        if (ncpuid) printf(", cpuid %u bytes: %s", cpuid[0].line_size, check(line == cpuid[0].line_size));
+        printf("\n");
+    } else printf("# line size: unknown, no clear step in the time per read at L2 sizes\n");
+
+    for (unsigned i = 0; i < n; i++) {
+        struct mountain_level const *l = &profile->levels[i];
+        bool const last = i + 1 == n;
+
+        if (last) printf("# memory: >= %"PRIu64"K", l->capacity >> 10);
+        else      printf("# L%u: %"PRIu64"K", i + 1, l->capacity >> 10);
+        printf(", %.2f ns, %.0f MB/s", l->ns, l->mb_per_sec);
+        if (!last) {
+            if (l->ways) printf(", %u ways", l->ways);
+            else         printf(", ways unknown");
+        }
 
-        if (!freq) {
-            fprintf(stderr, "could not determine processor base frequency, check leaf 0x16\n");
-            abort();
+        // powers of two only bound the capacity, the reported size should fall in [measured, 2 * measured]
+        if (!last && i < ncpuid) {
+            struct mountain_cache_level const *c = &cpuid[i];
+            printf(", cpuid %"PRIu64"K %u ways: %s", c->size >> 10, c->ways,
+                check(c->size >= l->capacity && c->size <= 2 * l->capacity));
+            if (l->ways && l->ways != c->ways) printf(" (ways differ)");
         }
 
-        if (debug("rdstc"))
-            fprintf(stderr, "processor base frequency (ghz * 10): %u\n", freq);
+        printf("\n");
     }
 
-    return cycles * 10 / freq;
+    // levels the sweep should have seen but didn't, either the sizes don't reach them or they're partitioned away
+    for (unsigned i = n - 1; i < ncpuid; i++) {
+        if (cpuid[i].size > max_size / 2) continue;
+        printf("# L%u: cpuid %"PRIu64"K not found in the measured sizes: MISMATCH\n",
+            cpuid[i].level, cpuid[i].size >> 10);
+    }
 }
 
-static uint64_t bench(struct bench_params const p, void (*fn)(void *args), void *args) {
-    uint64_t samples[p.k];
-    unsigned s = 0;
+#define MAX_PROBES (MOUNTAIN_MAX_LEVELS + 1)
+#define MAX_WINDOW (1 << 23)
+struct probe {
+    char name[8];
+    uint64_t size, window, offset;
+    volatile char *data;
+    struct mountain_read_args read;
+    struct mountain_chase_args chase;
+};
 
-    if (p.prime_cache)
-        (*fn)(args);
+// reads at most MAX_WINDOW bytes per sample, advancing through the probe's region so that a region
+// bigger than the last level cache is still read cold without streaming all of it every sample
+static void window_read(void *args) {
+    struct probe *p = args;
+    p->read.data = p->data + p->offset;
+    mountain_kernels[MOUNTAIN_UINT64](&p->read);
+    p->offset = (p->offset + p->window) % p->size;
+}
 
-    do {
-        bool const uts = p.use_rdtsc;
-        uint64_t start = now(uts);
-        (*fn)(args);
-        uint64_t elapsed = now(uts) - start;
-        if (uts) elapsed = cycles_to_ns(elapsed);
+// half of each cache level so that it fits with room to spare, and twice the last level for main memory
+static unsigned monitor_probes(
+    struct probe *probes, volatile char **bufp, uint64_t *bytes, struct args const *args
+) {
+    struct mountain_cache_level levels[MOUNTAIN_MAX_LEVELS];
+    unsigned const nlevels = mountain_cache_levels(levels, MOUNTAIN_MAX_LEVELS);
+    unsigned n = 0;
+    *bytes = 0;
+
+    for (unsigned i = 0; i < nlevels; i++) {
+        probes[n].size = levels[i].size / 2;
+        snprintf(probes[n++].name, sizeof probes->name, "L%u", levels[i].level);
+    }
+
+    probes[n].size = nlevels ? 2 * levels[nlevels - 1].size : UINT64_C(1) << 27;
+    snprintf(probes[n++].name, sizeof probes->name, "mem");
 
-        if (p.shift_samples) try_shift(samples, s, p);
-        sort_samples(samples, add_sample(samples, s++, elapsed, p));
-    } while (!has_converged(samples, s, p) && s < p.max_samples);
+    // whole pages, and whole windows once there's more than one
+    for (unsigned i = 0; i < n; i++) {
+        uint64_t const align = probes[i].size < MAX_WINDOW ? MOUNTAIN_PAGE_SIZE : MAX_WINDOW;
+        probes[i].size &= ~(align - 1);
+        *bytes += probes[i].size;
+    }
+
+    void *buf = NULL;
+    if (posix_memalign(&buf, MOUNTAIN_PAGE_SIZE, *bytes)) return 0;
+    if (!mountain_prepare(buf, *bytes, args->fill, args->mlock)) return free(buf), 0;
+
+    // each probe gets its own region, the chains are linked once up front and touch every page
+    volatile char *data = *bufp = buf;
+    uint64_t *order = malloc(probes[n - 1].size / MOUNTAIN_LINE_SIZE * sizeof *order);
+    if (!order) return free(buf), 0;
+
+    for (unsigned i = 0; i < n; i++) {
+        struct probe *p = &probes[i];
+        p->chase = (struct mountain_chase_args) { mountain_random_chain(data, p->size / MOUNTAIN_LINE_SIZE, order), MOUNTAIN_CHASE_LOADS };
+        p->window = p->size < MAX_WINDOW ? p->size : MAX_WINDOW;
+        p->offset = 0;
+        p->data = data;
+        p->read = (struct mountain_read_args) { .data = data, .n = p->window / sizeof (uint64_t), .stride = 1 };
+        data += p->size;
+    }
 
-    if (debug("collection"))
-        fprintf(stderr, "collected %d samples, result: %"PRIu64"\n", s, samples[0]);
+    free(order);
 
-    return samples[0];
+    return n;
 }
 
-struct read_data_args {
-    volatile void *data;
-    uint64_t n, stride;
+struct monitor_out {
+    char const *path, *socket;
+    uint64_t rotate_bytes;
+    FILE *file;
+    int fd;
 };
 
-#define define_read_data(name, T)                                       \
-static void name##_read_data(void *args) {                              \
-    struct read_data_args const *a = args;                              \
-    volatile T *data = a->data;                                         \
-    for (uint64_t i = 0; i < a->n; i += a->stride) data[i];             \
-    _mm_lfence();                                                       \
-}                                                                       \
-                                                                        \
-static void name##_read_data_sink(void *args) {                         \
-    struct read_data_args const *a = args;                              \
-    volatile T *data = a->data;                                         \
-    volatile T sink = { 0 };                                            \
-    T res = { 0 };                                                      \
-    for (uint64_t i = 0; i < a->n; i += a->stride) res += data[i];      \
-    sink = res;                                                         \
-}
-
-define_read_data(uint64, uint64_t)
-define_read_data(avx2, __m256i)
-
-static void (*benchmarks[])(void *args) = {
-    [UINT64]      = uint64_read_data,
-    [UINT64_SINK] = uint64_read_data_sink,
-    [AVX2]        = avx2_read_data,
-    [AVX2_SINK]   = avx2_read_data_sink
+static bool monitor_open(struct monitor_out *out) {
+    if (out->socket) {
+        struct sockaddr_un addr = { .sun_family = AF_UNIX };
+        strncpy(addr.sun_path, out->socket, sizeof addr.sun_path - 1);
+
+        out->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (out->fd < 0 || connect(out->fd, (struct sockaddr *) &addr, sizeof addr)) {
+            if (out->fd >= 0) close(out->fd);
+            out->fd = -1;
+            return false;
+        }
+    } else if (out->path) {
+        if (!(out->file = fopen(out->path, "a"))) return false;
+    } else out->file = stdout;
+
+    return true;
+}
+
+// a stream reconnects on the next round if the reader went away, a file is rotated to path.1 once it's too big
+static void monitor_write(struct monitor_out *out, char const *line, size_t n) {
+    if (out->socket) {
+        if (out->fd < 0 && !monitor_open(out)) return;
+        if (send(out->fd, line, n, MSG_NOSIGNAL) != (ssize_t) n) close(out->fd), out->fd = -1;
+        return;
+    }
+
+    fwrite(line, 1, n, out->file);
+    fflush(out->file);
+
+    if (out->path && (uint64_t) ftell(out->file) >= out->rotate_bytes) {
+        char rotated[PATH_MAX];
+        snprintf(rotated, sizeof rotated, "%s.1", out->path);
+        fclose(out->file);
+        rename(out->path, rotated);
+        if (!monitor_open(out)) fprintf(stderr, "could not reopen %s\n", out->path), exit(EXIT_FAILURE);
+    }
+}
+
+// a few samples per probe are enough to track changes over time, and keep each round short
+static struct mountain_bench_params const monitor_params = {
+    .prime_cache = true,
+    .timer = MOUNTAIN_CLOCK,
+    .k = 3,
+    .max_samples = 20,
+    .shift_samples = 0,
+    .denom = 20,
+    .base_spread = 2
 };
 
-static size_t element_size(enum benchmark b) {
-    switch (b) {
-        case UINT64:
-        case UINT64_SINK:
+// measure bandwidth and latency at one point per level every interval seconds, sleeping long enough
+// after each round that the probes never take more than duty percent of one cpu
+static bool monitor(struct args const *args) {
+    struct probe probes[MAX_PROBES];
+    volatile char *buf = NULL;
+    uint64_t bytes;
+    unsigned const n = monitor_probes(probes, &buf, &bytes, args);
+    if (!n) {
+        fprintf(stderr, "could not set up the probes\n");
+        return false;
+    }
+
+    struct monitor_out out = {
+        .path = args->output,
+        .socket = args->socket,
+        .rotate_bytes = (uint64_t) args->rotate_mb << 20,
+        .fd = -1
+    };
+
+    if (!monitor_open(&out) && !out.socket) {
+        fprintf(stderr, "could not open %s\n", out.path);
+        free((void *) buf);
+        return false;
+    }
+
+    struct mountain_bench_params params = monitor_params;
+    params.timer = args->use_rdtsc ? MOUNTAIN_RDTSC : MOUNTAIN_CLOCK;
+
+    for (unsigned round = 0; !args->rounds || round < args->rounds; round++) {
+        uint64_t const start = mountain_now(MOUNTAIN_CLOCK);
+
+        for (unsigned i = 0; i < n; i++) {
+            struct probe *p = &probes[i];
+            uint64_t const read_ns = mountain_bench(params, window_read, p);
+            double const chase_ns = (double) mountain_bench(params, mountain_chase, &p->chase) / MOUNTAIN_CHASE_LOADS;
+
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+
+            char line[128];
+            int const len = snprintf(line, sizeof line, "%lld.%03ld %s %"PRIu64" %"PRIu64" %.2f\n",
+                (long long) ts.tv_sec, ts.tv_nsec / 1000000, p->name, p->size,
+                p->window * 1000 / (read_ns ? read_ns : 1), chase_ns);
+            monitor_write(&out, line, len);
+        }
+
+        uint64_t const active = mountain_now(MOUNTAIN_CLOCK) - start,
+                       period = (uint64_t) args->monitor * ONE_SEC_NS,
+                       budget = active * 100 / args->duty;
+        uint64_t const idle = (period > budget ? period : budget) - active;
+
+        if (mountain_debug("monitor"))
+            fprintf(stderr, "round %u: active %"PRIu64" ns, idle %"PRIu64" ns\n", round, active, idle);
+
+        if (args->rounds && round + 1 == args->rounds) break;
+
+        struct timespec ts = { idle / ONE_SEC_NS, idle % ONE_SEC_NS };
+        while (nanosleep(&ts, &ts) && errno == EINTR);
+    }
+
+    if (out.fd >= 0) close(out.fd);
+    if (out.file && out.file != stdout) fclose(out.file);
+    free((void *) buf);
+
+    return true;
+}
+
+static char const *antagonist_str(enum antagonist a) {
+    switch (a) {
         default:
-            return sizeof (uint64_t);
-        case AVX2:
-        case AVX2_SINK:
-            return sizeof (__m256i);
+        case IDLE:   return "idle";
+        case STREAM: return "stream";
+        case CHASE:  return "chase";
+        case SPIN:   return "spin";
     }
 }
 
-#define define_max(cache, size)                                                           \
-__attribute__((noinline))                                                                 \
-static void bench_##cache##_avx2(volatile __m256i *data, bool throughput) {               \
-    uint64_t const N = (size) / sizeof (__m256i);                                         \
-    for (uint64_t i = 0; i < N; i++) data[i];                                             \
-    _mm_lfence();                                                                         \
-                                                                                          \
-    uint64_t min_elapsed = UINT64_MAX;                                                    \
-                                                                                          \
-    for (int t = 0; t < 32; t++) {                                                        \
-        bool const uts = true;                                                            \
-        uint64_t start = now(uts);                                                        \
-                                                                                          \
-        _Pragma("unroll")                                                                 \
-        for (uint64_t i = 0; i < N; i++) data[i];                                         \
-        _mm_lfence();                                                                     \
-                                                                                          \
-        uint64_t elapsed = now(uts) - start;                                              \
-        if (uts) elapsed = cycles_to_ns(elapsed);                                         \
-                                                                                          \
-        if (elapsed < min_elapsed) min_elapsed = elapsed;                                 \
-    }                                                                                     \
-                                                                                          \
-    if (throughput) printf("%"PRIu64" MB/s\n", (size) * UINT64_C(1000) / min_elapsed);    \
-    else            printf("%u %u %"PRIu64"\n", 1, (size), min_elapsed);                  \
+struct antagonist_args {
+    enum antagonist kind;
+    void (*fn)(void *args);
+    unsigned cpu;
+    bool pinned;
+    atomic_bool running, stop;
+    struct mountain_read_args read;
+    struct mountain_chase_args chase;
+};
+
+// a dependent chain of integer ops, keeps the shared execution ports busy without touching memory
+static void spin_alu(void *args) { (void) args;
+    uint64_t x = 1;
+    for (unsigned i = 0; i < MOUNTAIN_CHASE_LOADS; i++) x ^= x << 13, x ^= x >> 7, x ^= x << 17;
+    __asm__ volatile ("" :: "r" (x));
 }
 
-define_max(l1, 1 << 15)
-// define_max(l2, 1 << 18)
-// define_max(l3, 1 << 23)
+static bool pin(pthread_t thread, unsigned cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return !pthread_setaffinity_np(thread, sizeof set, &set);
+}
 
-static char *benchmark_str(enum benchmark b) {
-    switch (b) {
-        default:
-        case UINT64:      return "uint64";
-        case UINT64_SINK: return "uint64_sink";
-        case AVX2:        return "avx2";
-        case AVX2_SINK:   return "avx2_sink";
-        case L1_MAX:      return "l1_max";
-        case L2_MAX:      return "l2_max";
-        case L3_MAX:      return "l3_max";
+static void *antagonize(void *args) {
+    struct antagonist_args *a = args;
+    void *fargs = a->kind == CHASE ? (void *) &a->chase : (void *) &a->read;
+
+    a->pinned = pin(pthread_self(), a->cpu);
+    atomic_store(&a->running, true);
+    if (!a->pinned) return NULL;
+
+    while (!atomic_load_explicit(&a->stop, memory_order_relaxed)) (*a->fn)(fargs);
+
+    return NULL;
+}
+
+// the first other cpu in the kernel's list of hardware threads sharing cpu's core, "0,64" or "0-1"
+static bool smt_sibling(unsigned cpu, unsigned *sibling) {
+    char path[128];
+    snprintf(path, sizeof path, "/sys/devices/system/cpu/cpu%u/topology/thread_siblings_list", cpu);
+
+    FILE *f = fopen(path, "r");
+    if (!f) return false;
+
+    char list[256];
+    bool found = false;
+    if (fgets(list, sizeof list, f)) {
+        for (char *s = list, *end; *s && !found; s = end + (*end != '\0')) {
+            unsigned long lo = strtoul(s, &end, 10), hi = lo;
+            if (end == s) break;
+            if (*end == '-') hi = strtoul(end + 1, &end, 10);
+            for (unsigned long c = lo; c <= hi && !found; c++)
+                if (c != cpu) *sibling = c, found = true;
+        }
+    }
+
+    fclose(f);
+
+    return found;
+}
+
+struct steal {
+    double sum;
+    unsigned n;
+};
+
+// the mountain once per antagonist on the measuring cpu's SMT sibling, each as its own gnuplot data set,
+// followed by how much slower each cache level got compared to an idle sibling
+static bool sweep_smt(
+    struct args const *args, struct mountain_sweep const *sweep,
+    volatile char *data, struct mountain_grid *g
+) {
+    unsigned sibling = args->sibling;
+    if (sibling == NO_CPU && !smt_sibling(args->cpu, &sibling)) {
+        fprintf(stderr, "cpu %u has no SMT sibling, disable SMT or choose one with --sibling\n", args->cpu);
+        return false;
+    }
+
+    if (!pin(pthread_self(), args->cpu)) {
+        fprintf(stderr, "could not pin to cpu %u\n", args->cpu);
+        return false;
+    }
+
+    if (sibling >= sysconf(_SC_NPROCESSORS_ONLN)) {
+        fprintf(stderr, "sibling cpu %u is not online\n", sibling);
+        return false;
+    }
+
+    struct mountain_cache_level levels[MOUNTAIN_MAX_LEVELS];
+    unsigned const nlevels = mountain_cache_levels(levels, MOUNTAIN_MAX_LEVELS);
+
+    // streams and chains twice the size of the second level, so that the sibling misses its private caches
+    uint64_t const size = nlevels > 1 ? 2 * levels[1].size : UINT64_C(1) << 22;
+    void *abuf = NULL;
+    uint64_t *order = malloc(size / MOUNTAIN_LINE_SIZE * sizeof *order);
+    if (!order || posix_memalign(&abuf, MOUNTAIN_PAGE_SIZE, size)) {
+        fprintf(stderr, "antagonist allocation failed\n");
+        return free(order), false;
+    }
+
+    struct antagonist_args a = {
+        .cpu = sibling,
+        .read = { .data = abuf, .n = size / mountain_element_size(sweep->kernel), .stride = 1 },
+        .chase = { mountain_random_chain(abuf, size / MOUNTAIN_LINE_SIZE, order), MOUNTAIN_CHASE_LOADS }
+    };
+    free(order);
+
+    uint64_t const cells = g->nsizes * g->nstrides;
+    uint64_t *idle = malloc(cells * sizeof *idle);
+    if (!idle) {
+        fprintf(stderr, "grid allocation failed\n");
+        return free(abuf), false;
     }
+
+    bool success = true;
+    for (enum antagonist kind = IDLE; success && kind < ALL_ANTAGONISTS; kind++) {
+        if (kind != IDLE && args->antagonist != ALL_ANTAGONISTS && kind != args->antagonist) continue;
+
+        a.kind = kind;
+        a.fn = kind == STREAM ? mountain_kernels[sweep->kernel] : kind == CHASE ? mountain_chase : spin_alu;
+        atomic_store(&a.running, false);
+        atomic_store(&a.stop, false);
+
+        pthread_t thread;
+        if (kind != IDLE) {
+            if (pthread_create(&thread, NULL, antagonize, &a)) {
+                fprintf(stderr, "could not start the %s antagonist\n", antagonist_str(kind));
+                success = false;
+                break;
+            }
+
+            while (!atomic_load(&a.running)) _mm_pause();
+
+            if (!a.pinned) {
+                fprintf(stderr, "could not pin the antagonist to cpu %u\n", sibling);
+                pthread_join(thread, NULL);
+                success = false;
+                break;
+            }
+        }
+
+        printf("# antagonist: %s (cpu %u, sibling %u)\n", antagonist_str(kind), args->cpu, sibling);
+        success = mountain_sweep(sweep, data, g, &print_points);
+        printf("\n");
+
+        if (kind != IDLE) {
+            atomic_store(&a.stop, true);
+            pthread_join(thread, NULL);
+        }
+
+        if (kind == IDLE) {
+            memcpy(idle, g->times, cells * sizeof *idle);
+            continue;
+        }
+
+        struct steal steals[MOUNTAIN_MAX_LEVELS + 1] = { 0 };
+        for (unsigned i = 0; i < g->nsizes; i++) {
+            struct steal *s = &steals[mountain_level_of(g->sizes[i], levels, nlevels)];
+            for (unsigned j = 0; j < g->nstrides; j++, s->n++)
+                s->sum += 1.0 - (double) idle[i * g->nstrides + j] / g->times[i * g->nstrides + j];
+        }
+
+        printf("# %s steals:", antagonist_str(kind));
+        for (unsigned i = 0; i <= nlevels; i++) {
+            if (!steals[i].n) continue;
+            if (i < nlevels) printf(" L%u %.1f%%", levels[i].level, 100 * steals[i].sum / steals[i].n);
+            else             printf(" memory %.1f%%", 100 * steals[i].sum / steals[i].n);
+        }
+        printf(" of the idle bandwidth\n\n");
+    }
+
+    free(idle);
+    free(abuf);
+
+    return success;
 }
 
 int main(int argc, char const *argv[]) { (void) argc;
@@ -561,59 +1225,163 @@ int main(int argc, char const *argv[]) { (void) argc;
         .min_size_p2 = 10, // 2^10 bytes or 1 KB
         .max_size_p2 = 27,  // 2^27 bytes or 128 MB
         .shift_samples = 60,
+        .offset = 0,
+        .offset_step = 4,
+        .max_streams = MOUNTAIN_MAX_STREAMS,
+        .threads = 1,
+        .contention = MOUNTAIN_DISJOINT,
+        .sweep = MOUNTAIN,
         .prime_cache = true,
         .use_rdtsc = false,
         .throughput = false,
+        .analyze = false,
+        .monitor = 0,
+        .duty = 1,
+        .rounds = 0,
+        .output = NULL,
+        .rotate_mb = 16,
+        .socket = NULL,
+        .smt = false,
+        .cpu = 0,
+        .sibling = NO_CPU,
+        .antagonist = ALL_ANTAGONISTS,
+        .fill = 0xa5,
+        .mlock = false,
+        .flush = false,
+        .quick_profile = false,
+        .distribution = false,
+        .energy = false,
+        .rapl_root = NULL
     };
 
     if (!parse_args(&args, "1.0.0", argv))
         return EXIT_FAILURE;
 
-    if (debug("args"))
+    if (mountain_debug("args"))
         debug_args(&args);
 
     if (!validate_args(&args))
         return EXIT_FAILURE;
 
-    struct bench_params const params = {
-        .prime_cache = args.prime_cache,        // run the test before entering the timing loop to try and prime the cache
-        .k = 5,                                 // require k samples
-        .max_samples = 300,                     // give it 300 chances to converge
-        .shift_samples = args.shift_samples,    // every n samples shift the minimum off (helps with convergence if early readings were fast)
-        .denom = 100,                           // spread = min_value / denom + base_spread
-        .base_spread = 2,                       // at least 2 nanoseconds
-        .use_rdtsc = args.use_rdtsc
-    };
+    struct mountain_bench_params params = mountain_default_params;
+    params.prime_cache = args.prime_cache;
+    params.shift_samples = args.shift_samples;
+    params.timer = args.use_rdtsc ? MOUNTAIN_RDTSC : MOUNTAIN_CLOCK;
 
-    if (debug("bench_params"))
+    if (mountain_debug("bench_params"))
         debug_bench_params(&params);
 
-    if (debug("benchmark"))
+    if (mountain_debug("benchmark"))
         fprintf(stderr, "running benchmark: %s\n", benchmark_str(args.benchmark));
 
+    if (args.monitor)
+        return monitor(&args) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+    if (args.quick_profile) {
+        struct mountain_profile profile;
+        if (!mountain_quick_profile(&profile)) return EXIT_FAILURE;
+        print_profile(&profile, profile.levels[profile.nlevels - 1].capacity);
+        return EXIT_SUCCESS;
+    }
+
+    struct mountain_sweep sweep = {
+        .kernel = args.benchmark < L1_MAX ? (enum mountain_kernel) args.benchmark : MOUNTAIN_AVX2,
+        .stride_interval = args.stride_interval,
+        .start_stride = args.start_stride,
+        .end_stride = args.end_stride,
+        .min_size_p2 = args.min_size_p2,
+        .max_size_p2 = args.max_size_p2,
+        .offset_step = args.offset_step,
+        .max_streams = args.max_streams,
+        .threads = args.threads,
+        .contention = args.contention,
+        .offset = args.offset,
+        .flush = args.flush,
+        .params = params
+    };
+
+    struct mountain_rapl rapl;
+    if (args.energy) {
+        if (!mountain_rapl_open(&rapl, args.rapl_root)) return EXIT_FAILURE;
+        sweep.rapl = &rapl;
+    }
 
-    volatile void *data = malloc(1 << args.max_size_p2);
-    if (!data) {
+    // page align the buffer so that where loads split cache lines is decided by --offset, not the allocator,
+    // and huge page align it for --analyze to move onto huge pages, the slack past the largest size leaves
+    // room for the offsets, the alias sweep's write stream and disjoint threads get a span of their own
+    uint64_t const span = (UINT64_C(1) << args.max_size_p2) + MOUNTAIN_PAGE_SIZE,
+                   spans = args.sweep == ALIAS ? 2 : args.contention == MOUNTAIN_DISJOINT ? args.threads : 1;
+    void *buf = NULL;
+    if (posix_memalign(&buf, args.analyze ? MOUNTAIN_HUGE_PAGE_SIZE : MOUNTAIN_PAGE_SIZE, spans * span)) {
         fprintf(stderr, "data allocation failed\n");
         return EXIT_FAILURE;
     }
 
-    if (args.benchmark == L1_MAX)       bench_l1_avx2(data, args.throughput);
+    volatile char *data = buf;
+
+    if (!mountain_prepare(buf, spans * span, args.fill, args.mlock)) {
+        free(buf);
+        return EXIT_FAILURE;
+    }
+
+    // the sample arena, max_samples entries for every point of the sweep, written up front
+    // so that recording a sample never faults
+    if (args.distribution) {
+        uint64_t const bytes = sweep_points(&args, &sweep) * params.max_samples * sizeof *sweep.samples;
+
+        if (!(sweep.samples = malloc(bytes))) {
+            fprintf(stderr, "sample arena allocation failed\n");
+            free(buf);
+            return EXIT_FAILURE;
+        }
+
+        memset(sweep.samples, 0, bytes);
+    }
+
+    if (args.benchmark == L1_MAX)       bench_l1_avx2((volatile __m256i *) data, args.throughput);
     else if (args.benchmark == L2_MAX);  // bench_l2_avx2(data, args.throughput);
     else if (args.benchmark == L3_MAX);  // bench_l3_avx2(data, args.throughput);
-    else {
-        for (unsigned size = 1 << args.max_size_p2; size >= 1U << args.min_size_p2; size >>= 1) {
-            for (unsigned stride = args.start_stride; stride <= args.end_stride; stride += args.stride_interval) {
-                struct read_data_args fargs = { data, size / element_size(args.benchmark), stride };
-                uint64_t time = bench(params, benchmarks[args.benchmark], &fargs);
-                printf("%u %u %"PRIu64"\n", stride, size, time);
-            }
+    else if (args.sweep == STREAMS || args.sweep == CHAINS) {
+        struct scaling sc = { .chains = args.sweep == CHAINS };
+        struct mountain_callbacks const cb = { print_stream_point, print_stream_row, &sc };
+        if (!mountain_sweep_streams(&sweep, sc.chains ? MOUNTAIN_CHAINS : MOUNTAIN_STREAMS, data, &cb)) {
+            free(sweep.samples);
+            free(buf);
+            return EXIT_FAILURE;
+        }
+    } else if (args.sweep != MOUNTAIN) {
+        struct mountain_penalty penalties[MOUNTAIN_MAX_LEVELS + 1];
+        mountain_sweep_offsets(&sweep, args.sweep == ALIAS ? MOUNTAIN_ALIAS : MOUNTAIN_ALIGN,
+            data, span, penalties, &print_offset_points);
+        print_penalties(penalties, args.sweep == ALIAS);
+    } else {
+        unsigned const nsizes = mountain_sweep_sizes(&sweep),
+                       nstrides = mountain_sweep_strides(&sweep);
+        uint64_t sizes[nsizes];
+        uint64_t strides[nstrides];
+        struct mountain_grid g = { nsizes, nstrides, sizes, strides, NULL, 0 };
+
+        if ((args.analyze || args.smt) && !(g.times = malloc(nsizes * nstrides * sizeof *g.times))) {
+            fprintf(stderr, "grid allocation failed\n");
+            return EXIT_FAILURE;
+        }
+
+        bool success = true;
+        if (args.smt) success = sweep_smt(&args, &sweep, data, &g);
+        else          success = mountain_sweep(&sweep, data, &g, &print_points);
 
-            printf("\n");
+        if (success && args.analyze) {
+            struct mountain_profile profile;
+            success = mountain_analyze(&g, &sweep, data, span, &profile);
+            if (success) print_profile(&profile, sizes[nsizes - 1]);
         }
+
+        free(g.times);
+        if (!success) return EXIT_FAILURE;
     }
 
-    free((void *) data);
+    free(sweep.samples);
+    free(buf);
 
     return EXIT_SUCCESS;
 }
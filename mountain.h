@@ -0,0 +1,273 @@
+#ifndef MOUNTAIN_H
+#define MOUNTAIN_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define MOUNTAIN_PAGE_SIZE 4096
+#define MOUNTAIN_HUGE_PAGE_SIZE (UINT64_C(1) << 21)
+#define MOUNTAIN_LINE_SIZE 64
+#define MOUNTAIN_MAX_LEVELS 8
+#define MOUNTAIN_CHASE_LOADS 4096
+#define MOUNTAIN_HIST_BUCKETS 8
+#define MOUNTAIN_MAX_STREAMS 32
+#define MOUNTAIN_MAX_THREADS 64
+#define MOUNTAIN_MAX_ZONES 16
+#define MOUNTAIN_PATH_MAX 256
+
+enum mountain_kernel {
+    MOUNTAIN_UINT64,
+    MOUNTAIN_UINT64_SINK,
+    MOUNTAIN_AVX2,
+    MOUNTAIN_AVX2_SINK,
+    MOUNTAIN_FETCH_ADD,             // lock xadd
+    MOUNTAIN_CAS,                   // lock cmpxchg, one attempt per element
+    MOUNTAIN_XCHG,                  // xchg, implicitly locked
+    MOUNTAIN_KERNELS
+};
+
+enum mountain_timer {
+    MOUNTAIN_CLOCK,     // CLOCK_MONOTONIC_RAW
+    MOUNTAIN_RDTSC      // rdtsc, converted to nanoseconds with the base frequency from cpuid
+};
+
+struct mountain_bench_params {
+    bool prime_cache;               // run the test before entering the timing loop to try and prime the cache
+    enum mountain_timer timer;
+    uint8_t k;                      // require k samples
+    unsigned
+        max_samples,                // chances to converge
+        shift_samples,              // every n samples shift the minimum off, 0 to never shift
+        denom,                      // spread = min_value / denom + base_spread
+        base_spread;
+    volatile char const *flush;     // flushed from the caches before every sample when set
+    uint64_t flush_bytes;
+    uint64_t *samples;              // every raw sample is appended here when set, needs room for max_samples
+    unsigned *nsamples;             // and counted here
+};
+
+// what the mountain cli runs with
+extern struct mountain_bench_params const mountain_default_params;
+
+// DEBUG=key or DEBUG=* in the environment
+bool mountain_debug(char const *key);
+
+uint64_t mountain_now(enum mountain_timer timer);
+uint64_t mountain_cycles_to_ns(uint64_t cycles);
+void mountain_flush(volatile char const *data, uint64_t bytes);
+
+// the minimum time in nanoseconds of fn(args) once k samples agree
+uint64_t mountain_bench(struct mountain_bench_params const p, void (*fn)(void *args), void *args);
+
+struct mountain_distribution {
+    uint64_t min, p50, p90, p99, max;
+    unsigned hist[MOUNTAIN_HIST_BUCKETS];   // samples within 1.05, 1.1, 1.25, 1.5, 2, 4, 8 and over 8 times min
+};
+
+// nearest rank percentiles, n > 0
+void mountain_distribution(uint64_t const *samples, unsigned n, struct mountain_distribution *d);
+
+struct mountain_read_args {
+    volatile void *data, *dst;
+    uint64_t n, stride;             // n elements, every stride-th one is read
+    bool one_line,                  // atomic kernels, touch the words of the first line instead of the ones walked
+         false_sharing;             // atomic kernels, only touch word lane of each line the walk reaches
+    unsigned lane;
+};
+
+// read kernels, atomic read-modify-write kernels that need 8 byte aligned data,
+// and two stream kernels that read from data and write to dst, NULL for the atomic kernels
+extern void (*const mountain_kernels[MOUNTAIN_KERNELS])(void *args);
+extern void (*const mountain_copy_kernels[MOUNTAIN_KERNELS])(void *args);
+size_t mountain_element_size(enum mountain_kernel k);
+char const *mountain_kernel_str(enum mountain_kernel k);
+
+struct mountain_chase_args {
+    void *volatile *head;
+    uint64_t loads;
+};
+
+// dependent loads through a chain, continues from where the last call stopped
+void mountain_chase(void *args);
+struct mountain_streams_args {
+    volatile char *data;
+    uint64_t region, lines;         // bytes between the starts of the streams, lines read from each
+    unsigned streams;
+};
+
+// one load per line from each of streams regions in turn
+void mountain_streams(void *args);
+
+struct mountain_chains_args {
+    void *volatile *heads[MOUNTAIN_MAX_STREAMS];
+    unsigned chains;
+    uint64_t loads;                 // per chain
+};
+
+// a dependent load from each of the chains in turn, the chains are independent of each other
+void mountain_chase_chains(void *args);
+
+// one node per line in a random cycle, order needs room for nodes entries, and at least one
+void *volatile *mountain_random_chain(volatile char *base, uint64_t nodes, uint64_t *order);
+// k nodes spaced apart by spacing
+void *volatile *mountain_conflict_chain(volatile char *base, unsigned k, uint64_t spacing);
+// nanoseconds per load, after walking up to the first 4M nodes of the chain once
+double mountain_chase_ns(struct mountain_bench_params const params, void *volatile *head, uint64_t nodes);
+
+struct mountain_cache_level {
+    unsigned level, line_size, ways, sets;
+    uint64_t size;
+};
+
+// data and unified caches as reported by cpuid, smallest first
+unsigned mountain_cache_levels(struct mountain_cache_level *levels, unsigned max);
+// index of the smallest level that fits size, or n for main memory
+unsigned mountain_level_of(uint64_t size, struct mountain_cache_level const *levels, unsigned n);
+
+// write fill over every page, from several threads for large buffers, optionally mlock them,
+// and warn about pages mincore says aren't resident
+bool mountain_prepare(void *buf, uint64_t bytes, uint8_t fill, bool lock);
+
+enum mountain_rapl_kind {
+    MOUNTAIN_PACKAGE,
+    MOUNTAIN_DRAM,
+    MOUNTAIN_RAPL_KINDS
+};
+
+struct mountain_rapl_zone {
+    enum mountain_rapl_kind kind;
+    uint64_t max_uj;                // energy_uj wraps around to 0 past this
+    char path[MOUNTAIN_PATH_MAX];   // of energy_uj
+};
+
+struct mountain_rapl {
+    unsigned n;
+    struct mountain_rapl_zone zones[MOUNTAIN_MAX_ZONES];
+};
+
+// the package and dram powercap zones under root, /sys/class/powercap when NULL, false if there are none
+// or they can't be read, energy_uj is only readable by root on most kernels
+bool mountain_rapl_open(struct mountain_rapl *r, char const *root);
+// energy_uj of every zone
+bool mountain_rapl_read(struct mountain_rapl const *r, uint64_t *uj);
+// microjoules of each kind between two reads, summed over sockets, NAN for kinds without a zone
+void mountain_rapl_energy(struct mountain_rapl const *r, uint64_t const *before, uint64_t const *after, double *uj);
+
+// disjoint comes first so that a zeroed sweep doesn't turn the atomics into a one line benchmark
+enum mountain_contention {
+    MOUNTAIN_DISJOINT,              // every thread walks its own copy of the size, nothing is shared
+    MOUNTAIN_LINE,                  // every thread's atomics hit one shared line, the read kernels walk the same words
+    MOUNTAIN_FALSE_SHARING          // every thread walks the same lines, but each touches its own word of them
+};
+
+struct mountain_sweep {
+    enum mountain_kernel kernel;
+    uint64_t stride_interval,       // interval=[1,n] where interval divides max_stride
+             start_stride,          // stride=[1,n] where start < end
+             end_stride;
+    uint8_t min_size_p2,            // size=2^n where min_size < max_size <= 63
+            max_size_p2,
+            offset_step,            // step=[1,n] for the align sweep
+            max_streams,            // streams=[1,32] for the stream and chain sweeps
+            threads;                // threads=[1,64] running each mountain point at once, only the first is timed
+    enum mountain_contention contention;    // false sharing allows up to 8 threads
+    uint16_t offset;                // offset=[0,4095] bytes from the page aligned start of the data
+    bool flush;                     // measure every point cold
+    uint64_t *samples;              // params.max_samples entries per point in sweep order, to record every sample, or NULL
+    struct mountain_rapl const *rapl;   // mountain sweep with one thread and no flush, measure the energy of every point when set
+    struct mountain_bench_params params;
+};
+
+struct mountain_point {
+    uint64_t x;                     // the stride, or the offset in bytes for the offset sweeps
+    uint64_t size, ns;
+    double penalty;                 // offset sweeps, percent slower than the fastest offset at this size
+    uint64_t const *samples;        // every sample of the point when the sweep records them, else NULL
+    unsigned nsamples;
+    uint64_t loads;                 // stream and chain sweeps, loads in one sample
+    bool energy;                    // mountain sweeps with rapl set, nj_per_byte holds energy per byte read
+    double nj_per_byte[MOUNTAIN_RAPL_KINDS];    // NAN for kinds without a zone
+};
+
+struct mountain_callbacks {
+    void (*point)(void *ctx, struct mountain_point const *p);
+    void (*row)(void *ctx, uint64_t size);  // after the last point of each size, may be NULL
+    void *ctx;
+};
+
+// (stride, size, time) points of a sweep, sized with mountain_sweep_sizes and mountain_sweep_strides
+struct mountain_grid {
+    unsigned nsizes, nstrides;
+    uint64_t *sizes, *strides;      // both ascending
+    uint64_t *times;                // times[size index * nstrides + stride index], or NULL to not keep them
+    uint64_t overhead;              // time of an empty pass, set by mountain_analyze
+};
+
+unsigned mountain_sweep_sizes(struct mountain_sweep const *s);
+unsigned mountain_sweep_strides(struct mountain_sweep const *s);
+
+// every size from largest to smallest, every stride from start to end, data needs a span of
+// 2^max_size_p2 + MOUNTAIN_PAGE_SIZE bytes, or threads spans for disjoint threads, false if the threads can't start
+bool mountain_sweep(
+    struct mountain_sweep const *s, volatile char *data,
+    struct mountain_grid *g, struct mountain_callbacks const *cb
+);
+
+enum mountain_offsets {
+    MOUNTAIN_ALIGN,                 // the base offset over [0,63] bytes, reads split cache lines
+    MOUNTAIN_ALIAS                  // the page offset of a write stream from the read stream, 4K aliasing
+};
+
+// offsets per size in an offset sweep
+unsigned mountain_sweep_offset_count(struct mountain_sweep const *s, enum mountain_offsets kind);
+
+struct mountain_penalty {
+    double sum, max;
+    unsigned n, max_offset;
+};
+
+// penalties has MOUNTAIN_MAX_LEVELS + 1 entries, one per cpuid cache level and one for main memory,
+// the alias sweep writes to base + span, so base needs 2 * span bytes and each size is filed under
+// the level that holds twice it
+void mountain_sweep_offsets(
+    struct mountain_sweep const *s, enum mountain_offsets kind, volatile char *base, uint64_t span,
+    struct mountain_penalty *penalties, struct mountain_callbacks const *cb
+);
+
+enum mountain_streams {
+    MOUNTAIN_STREAMS,               // independent sequential streams, each one over its own part of the size
+    MOUNTAIN_CHAINS                 // independent random pointer chases, interleaved
+};
+
+// x=[1,max_streams] streams or chains at every size, points where a stream or chain
+// would get less than a line are skipped, chains overwrite data
+bool mountain_sweep_streams(
+    struct mountain_sweep const *s, enum mountain_streams kind,
+    volatile char *data, struct mountain_callbacks const *cb
+);
+
+struct mountain_level {
+    uint64_t capacity;              // the largest size in the level, or the smallest for main memory
+    unsigned ways;                  // 0 when unknown
+    double ns, mb_per_sec;          // load to use latency, sustained unit stride read bandwidth
+};
+
+struct mountain_profile {
+    unsigned line_size;             // 0 when unknown
+    unsigned nlevels;               // levels[nlevels - 1] is main memory
+    struct mountain_level levels[MOUNTAIN_MAX_LEVELS + 1];
+};
+
+// the cache hierarchy implied by a swept grid and a latency sweep over the same sizes,
+// base is overwritten and needs span >= 2^max_size_p2 bytes, align it to MOUNTAIN_HUGE_PAGE_SIZE
+// so it can be moved onto huge pages before the latency chases
+bool mountain_analyze(
+    struct mountain_grid *g, struct mountain_sweep const *s,
+    volatile char *base, uint64_t span, struct mountain_profile *profile
+);
+
+// capacity, latency and bandwidth of each level in well under a second, for sizing buffers at startup
+bool mountain_quick_profile(struct mountain_profile *profile);
+
+#endif